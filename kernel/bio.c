@@ -1,13 +1,15 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
 //
 // Interface:
 // * To get a buffer for a particular disk block, call bread.
-// * After changing buffer data, call bwrite to write it to disk.
+// * After changing buffer data, call bwrite to write it to disk,
+//     bawrite to start writing it without waiting, or bdirty
+//     to leave the write to the flusher thread.
 // * When done with the buffer, call brelse.
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
@@ -16,6 +18,7 @@
 
 #include "types.h"
 #include "param.h"
+#include "memlayout.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "riscv.h"
@@ -23,69 +26,312 @@
 #include "fs.h"
 #include "buf.h"
 
+// Buffers live in pages from kalloc(), BPP to a page. The cache
+// starts with enough pages for NBUF buffers and grows a page at
+// a time on misses, up to 1/BCACHEFRAC of RAM, as long as kalloc()
+// has more than BRESERVE pages left. When kalloc() runs out, it
+// calls breclaim(), which frees pages whose buffers are unused.
+#define BPP ((PGSIZE - sizeof(void*)) / sizeof(struct buf))
+#define BMINPAGES ((NBUF + BPP - 1) / BPP)
+#define BMAXPAGES ((PHYSTOP - KERNBASE) / PGSIZE / BCACHEFRAC)
+#define BRESERVE 256    // pages
+#define BRECLAIM 16     // pages breclaim() frees at most
+
+struct bufpage {
+  struct bufpage *next;
+  struct buf buf[BPP];
+};
+
+struct bucket {
+  struct spinlock lock;
+  struct buf *head;     // the bucket's buffers, through next
+};
+
 struct {
+  // Held while moving a buffer between buckets, so only
+  // one process evicts at a time, and while adding and
+  // removing pages. Never needed on a hit.
   struct spinlock lock;
-  struct buf buf[NBUF];
+  struct bufpage *pages;
+  int npages;
+
+  // Buffers are hashed on (dev, blockno) into buckets, each
+  // with its own lock, so lookups of different blocks
+  // don't contend. A buffer's bucket lock protects its
+  // dev, blockno, refcnt, lastuse and list link.
+  struct bucket bucket[NBUCKET];
 
-  // Linked list of all buffers, through prev/next.
-  // Sorted by how recently the buffer was used.
-  // head.next is most recent, head.prev is least.
-  struct buf head;
+  // Dirty buffers, oldest first. dirtylock protects the
+  // list, b->dirty and b->dirtied, and the count of writes
+  // started by bawrite() that the disk hasn't finished.
+  struct spinlock dirtylock;
+  struct buf *dirty;
+  int nwriting;
 } bcache;
 
+static void bput(struct buf*);
+
+static struct bucket*
+hash(uint dev, uint blockno)
+{
+  return &bcache.bucket[(dev * 31 + blockno) % NBUCKET];
+}
+
+static void
+bunlink(struct bucket *bk, struct buf *b)
+{
+  struct buf **pp;
+
+  for(pp = &bk->head; *pp != b; pp = &(*pp)->next)
+    ;
+  *pp = b->next;
+}
+
+static void
+blink(struct bucket *bk, struct buf *b)
+{
+  b->next = bk->head;
+  bk->head = b;
+}
+
+// Add a page of buffers to the cache. Like the buffers binit()
+// used to start with, they hold block 0 of device 0, invalid,
+// and are unused since time 0, so bget() recycles them first.
+// Caller holds bcache.lock. Returns 0 if the cache is at its
+// limit or memory is short.
+static int
+bgrow(void)
+{
+  struct bufpage *pg;
+  struct bucket *bk = hash(0, 0);
+  struct buf *b;
+
+  if(bcache.npages >= BMAXPAGES ||
+     (bcache.npages >= BMINPAGES && kfreepages() <= BRESERVE) ||
+     (pg = kalloc()) == 0)
+    return 0;
+  for(b = pg->buf; b < pg->buf+BPP; b++){
+    b->valid = 0;
+    b->disk = 0;
+    b->dev = 0;
+    b->blockno = 0;
+    b->refcnt = 0;
+    b->lastuse = 0;
+    b->dirty = 0;
+    initsleeplock(&b->lock, "buffer");
+  }
+  acquire(&bk->lock);
+  for(b = pg->buf; b < pg->buf+BPP; b++)
+    blink(bk, b);
+  release(&bk->lock);
+  pg->next = bcache.pages;
+  bcache.pages = pg;
+  bcache.npages++;
+  return 1;
+}
+
 void
 binit(void)
 {
-  struct buf *b;
+  struct bucket *bk;
 
+  if(sizeof(struct bufpage) > PGSIZE)
+    panic("binit: bufpage");
   initlock(&bcache.lock, "bcache");
+  initlock(&bcache.dirtylock, "bcache.dirty");
+  for(bk = bcache.bucket; bk < bcache.bucket+NBUCKET; bk++){
+    initlock(&bk->lock, "bcache.bucket");
+    bk->head = 0;
+  }
 
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+  acquire(&bcache.lock);
+  while(bcache.npages < BMINPAGES)
+    if(!bgrow())
+      panic("binit");
+  release(&bcache.lock);
+}
+
+// Number of buffers in the cache.
+int
+bcachesize(void)
+{
+  return bcache.npages * BPP;
+}
+
+// Look for block blockno of dev in bucket bk, whose lock
+// the caller holds, and take a reference to it.
+static struct buf*
+bfind(struct bucket *bk, uint dev, uint blockno)
+{
+  struct buf *b;
+
+  for(b = bk->head; b; b = b->next){
+    if(b->dev == dev && b->blockno == blockno){
+      b->refcnt++;
+      return b;
+    }
   }
+  return 0;
 }
 
 // Look through buffer cache for block on device dev.
 // If not found, allocate a buffer.
-// In either case, return locked buffer.
+// In either case, return locked buffer. If every buffer
+// is in use, panic, or return 0 if canfail.
 static struct buf*
-bget(uint dev, uint blockno)
+bget(uint dev, uint blockno, int canfail)
 {
-  struct buf *b;
+  struct bucket *bk = hash(dev, blockno), *vk, *k;
+  struct buf *b, *victim;
+
+  // Is the block already cached?
+  acquire(&bk->lock);
+  b = bfind(bk, dev, blockno);
+  release(&bk->lock);
+  if(b){
+    cpustat(CS_BHIT, 1);
+    acquiresleep(&b->lock);
+    return b;
+  }
 
+  // Not cached. Only evictors add buffers to a bucket, so
+  // once we hold bcache.lock, a second look settles whether
+  // somebody else brought the block in meanwhile.
   acquire(&bcache.lock);
+  acquire(&bk->lock);
+  b = bfind(bk, dev, blockno);
+  release(&bk->lock);
+  if(b){
+    release(&bcache.lock);
+    cpustat(CS_BHIT, 1);
+    acquiresleep(&b->lock);
+    return b;
+  }
 
-  // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
-    if(b->dev == dev && b->blockno == blockno){
-      b->refcnt++;
+  // Grow rather than evict while there is room; the
+  // fresh buffers are the oldest, so the scan finds them.
+  bgrow();
+
+  // Recycle the least recently used unused buffer in any
+  // bucket, keeping the lock of the bucket that holds the
+  // best one so far. At most two bucket locks are held at
+  // once, and only by the single evictor, so this can't
+  // deadlock with anybody.
+  victim = 0;
+  vk = 0;
+  for(k = bcache.bucket; k < bcache.bucket+NBUCKET; k++){
+    int better = 0;
+    acquire(&k->lock);
+    for(b = k->head; b; b = b->next){
+      if(b->refcnt == 0 && (victim == 0 || b->lastuse < victim->lastuse)){
+        victim = b;
+        better = 1;
+      }
+    }
+    if(better){
+      if(vk)
+        release(&vk->lock);
+      vk = k;
+    } else {
+      release(&k->lock);
+    }
+  }
+  if(victim == 0){
+    if(canfail){
       release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
+      return 0;
     }
+    panic("bget: no buffers");
   }
 
-  // Not cached.
-  // Recycle the least recently used (LRU) unused buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
+  victim->dev = dev;
+  victim->blockno = blockno;
+  victim->valid = 0;
+  victim->refcnt = 1;
+  if(vk != bk){
+    bunlink(vk, victim);
+    release(&vk->lock);
+    acquire(&bk->lock);
+    blink(bk, victim);
+  }
+  release(&bk->lock);
+  release(&bcache.lock);
+  cpustat(CS_BMISS, 1);
+  acquiresleep(&victim->lock);
+  return victim;
+}
+
+// If none of pg's buffers is in use, take them out of the
+// cache and return 1. Caller holds bcache.lock, so no buffer
+// changes bucket meanwhile and no block can be brought in: a
+// lookup of a buffer already taken out misses and waits for
+// bcache.lock. So the buffers can go one bucket lock at a
+// time, and be put back if a later one is in use. breclaim()
+// runs inside kalloc(), under whatever locks its caller
+// holds, so it must not add more than one bucket lock.
+static int
+bpagetake(struct bufpage *pg)
+{
+  struct bucket *bk;
+  struct buf *b;
+  int n;
+
+  for(n = 0; n < BPP; n++){
+    b = &pg->buf[n];
+    bk = hash(b->dev, b->blockno);
+    acquire(&bk->lock);
+    if(b->refcnt != 0){
+      release(&bk->lock);
+      break;
     }
+    bunlink(bk, b);
+    release(&bk->lock);
   }
-  panic("bget: no buffers");
+  if(n == BPP)
+    return 1;
+  while(--n >= 0){
+    b = &pg->buf[n];
+    bk = hash(b->dev, b->blockno);
+    acquire(&bk->lock);
+    blink(bk, b);
+    release(&bk->lock);
+  }
+  return 0;
+}
+
+// Give pages of unused buffers back to kalloc(), which
+// calls this when it runs out. Returns how many pages
+// were freed.
+int
+breclaim(void)
+{
+  struct bufpage *pg, **pp;
+  int i, n = 0, h;
+
+  // bgrow() calls kalloc() with bcache.lock held.
+  push_off();
+  h = holding(&bcache.lock);
+  pop_off();
+  if(h)
+    return 0;
+
+  acquire(&bcache.lock);
+  pp = &bcache.pages;
+  while(*pp && n < BRECLAIM && bcache.npages > BMINPAGES){
+    pg = *pp;
+    if(!bpagetake(pg)){
+      pp = &pg->next;
+      continue;
+    }
+    *pp = pg->next;
+    bcache.npages--;
+    for(i = 0; i < BPP; i++)
+      freesleeplock(&pg->buf[i].lock);
+    kfree(pg);
+    n++;
+  }
+  release(&bcache.lock);
+  return n;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -94,7 +340,9 @@ bread(uint dev, uint blockno)
 {
   struct buf *b;
 
-  b = bget(dev, blockno);
+  b = bget(dev, blockno, 0);
+  if(b->disk)   // still being read ahead or written back
+    virtio_disk_wait(b);
   if(!b->valid) {
     virtio_disk_rw(b, 0);
     b->valid = 1;
@@ -102,52 +350,264 @@ bread(uint dev, uint blockno)
   return b;
 }
 
+// Take b off the dirty list. Its reference passes to the caller.
+static void
+bclean(struct buf *b)
+{
+  struct buf **pp;
+
+  acquire(&bcache.dirtylock);
+  for(pp = &bcache.dirty; *pp != b; pp = &(*pp)->dnext)
+    ;
+  *pp = b->dnext;
+  b->dirty = 0;
+  release(&bcache.dirtylock);
+}
+
+// Start writing b's contents to disk, and return without
+// waiting. Must be locked. bread() of b, or bwait(), waits
+// for the write to finish. The write sits in the disk's queue,
+// where it may merge with writes of the blocks next to it,
+// until bsubmit() or the next wait.
+void
+bawrite(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("bawrite");
+  // the write holds a reference until bdone(): a dirty
+  // buffer's own, or a new one.
+  if(b->dirty)
+    bclean(b);
+  else
+    bpin(b);
+  acquire(&bcache.dirtylock);
+  b->writing = 1;
+  bcache.nwriting++;
+  release(&bcache.dirtylock);
+  virtio_disk_start(b, 1);
+}
+
+// Wait for a write started by bawrite(). The caller must
+// hold a reference to b.
+void
+bwait(struct buf *b)
+{
+  virtio_disk_wait(b);
+}
+
+// Hand the reads and writes queued by breada() and bawrite()
+// to the disk, for a caller that won't wait for them.
+void
+bsubmit(void)
+{
+  virtio_disk_kick();
+}
+
 // Write b's contents to disk.  Must be locked.
 void
 bwrite(struct buf *b)
 {
   if(!holdingsleep(&b->lock))
     panic("bwrite");
-  virtio_disk_rw(b, 1);
+  bawrite(b);
+  bwait(b);
 }
 
-// Release a locked buffer.
-// Move to the head of the most-recently-used list.
+// Mark b, which the caller has locked and changed, to be
+// written back later, by the flusher after DIRTYAGE ticks or
+// by bflush(). A dirty buffer keeps a reference, so it stays
+// in the cache until written.
 void
-brelse(struct buf *b)
+bdirty(struct buf *b)
 {
+  struct buf **pp;
+
   if(!holdingsleep(&b->lock))
-    panic("brelse");
+    panic("bdirty");
+  if(b->dirty)
+    return;
+  bpin(b);
+  acquire(&bcache.dirtylock);
+  b->dirty = 1;
+  b->dirtied = ticks;
+  b->dnext = 0;
+  for(pp = &bcache.dirty; *pp; pp = &(*pp)->dnext)
+    ;
+  *pp = b;
+  release(&bcache.dirtylock);
+}
+
+// Wait until every write started by bawrite() has reached
+// the disk, including ones started by other processes, which
+// bwait() wouldn't see.
+void
+bsync(void)
+{
+  acquire(&bcache.dirtylock);
+  while(bcache.nwriting > 0){
+    release(&bcache.dirtylock);
+    virtio_disk_kick();   // in case they are still queued
+    acquire(&bcache.dirtylock);
+    if(bcache.nwriting > 0)
+      sleep(&bcache.nwriting, &bcache.dirtylock);
+  }
+  release(&bcache.dirtylock);
+}
+
+// If b is dirty, forget that: the caller is about to change it
+// and will see that its committed contents get home some other
+// way. Returns whether b was dirty. Must be locked.
+int
+bundirty(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("bundirty");
+  // only holders of b's lock change b->dirty.
+  if(!b->dirty)
+    return 0;
+  bclean(b);
+  bput(b);   // the dirty buffer's reference
+  return 1;
+}
+
+// Write back the buffers that have been dirty for at least
+// minage ticks, oldest first, and wait for them. The writes
+// are all started before the first wait, so the disk can
+// work on several at once.
+#define NFLUSH 64
+
+void
+bflush(uint minage)
+{
+  struct buf *b, *started[NFLUSH];
+  int i, n;
+
+  do {
+    for(n = 0; n < NFLUSH; n++){
+      acquire(&bcache.dirtylock);
+      b = bcache.dirty;
+      if(b == 0 || ticks - b->dirtied < minage){
+        release(&bcache.dirtylock);
+        break;
+      }
+      bpin(b);    // so it can't go away before bwait()
+      release(&bcache.dirtylock);
+
+      acquiresleep(&b->lock);
+      if(b->dirty)   // else somebody beat us to it
+        bawrite(b);
+      releasesleep(&b->lock);
+      started[n] = b;
+    }
+    for(i = 0; i < n; i++){
+      bwait(started[i]);
+      bunpin(started[i]);
+    }
+  } while(n == NFLUSH);
+}
+
+// The flusher kernel thread. Once a tick, it writes back
+// the buffers that have been dirty for DIRTYAGE ticks, and
+// lets the log reuse the space of transactions whose blocks
+// are all home.
+void
+flusher(void)
+{
+  for(;;){
+    acquire(&tickslock);
+    sleep(&ticks, &tickslock);
+    release(&tickslock);
+
+    bflush(DIRTYAGE);
+    log_checkpoint(DIRTYAGE);
+  }
+}
+
+// Start reading the indicated block into the cache, unless
+// it is there already, and return without waiting for the
+// disk. A later bread() of the block waits for it. Like
+// bawrite(), the read is only queued until bsubmit().
+void
+breada(uint dev, uint blockno)
+{
+  struct bucket *bk = hash(dev, blockno);
+  struct buf *b;
 
+  acquire(&bk->lock);
+  for(b = bk->head; b; b = b->next)
+    if(b->dev == dev && b->blockno == blockno)
+      break;
+  release(&bk->lock);
+  if(b)
+    return;
+
+  // a guess isn't worth a panic if every buffer is busy.
+  if((b = bget(dev, blockno, 1)) == 0)
+    return;
+  if(b->valid || b->disk){
+    brelse(b);
+    return;
+  }
+  // the disk holds our reference until bdone(), and
+  // anyone who gets b first waits in bread().
+  b->valid = 1;
+  cpustat(CS_READAHEAD, 1);
+  virtio_disk_start(b, 0);
   releasesleep(&b->lock);
+}
 
-  acquire(&bcache.lock);
+// Drop a reference to b.
+// Stamp it with the time, for LRU eviction by bget().
+static void
+bput(struct buf *b)
+{
+  struct bucket *bk = hash(b->dev, b->blockno);
+
+  acquire(&bk->lock);
   b->refcnt--;
   if (b->refcnt == 0) {
     // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
-  }
-  
-  release(&bcache.lock);
+    b->lastuse = r_time();
+  }
+  release(&bk->lock);
+}
+
+// The disk has finished a read started by breada(), or a
+// write started by bawrite(). Called from the disk interrupt.
+void
+bdone(struct buf *b)
+{
+  if(b->writing){
+    acquire(&bcache.dirtylock);
+    b->writing = 0;
+    if(--bcache.nwriting == 0)
+      wakeup(&bcache.nwriting);
+    release(&bcache.dirtylock);
+  }
+  bput(b);
+}
+
+// Release a locked buffer.
+void
+brelse(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("brelse");
+
+  releasesleep(&b->lock);
+  bput(b);
 }
 
 void
 bpin(struct buf *b) {
-  acquire(&bcache.lock);
+  struct bucket *bk = hash(b->dev, b->blockno);
+
+  acquire(&bk->lock);
   b->refcnt++;
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
 void
 bunpin(struct buf *b) {
-  acquire(&bcache.lock);
-  b->refcnt--;
-  release(&bcache.lock);
+  bput(b);
 }
-
-
@@ -1,12 +1,17 @@
 struct buf {
   int valid;   // has data been read from disk?
   int disk;    // does disk "own" buf?
+  int vq;      // the virtio queue it's on, while disk is set
   uint dev;
   uint blockno;
   struct sleeplock lock;
   uint refcnt;
-  struct buf *prev; // LRU cache list
-  struct buf *next;
+  uint64 lastuse;   // time of the last brelse(), for LRU
+  struct buf *next; // hash bucket list
+  int dirty;        // changed, but not yet written to disk?
+  uint dirtied;     // when it became dirty, in ticks
+  struct buf *dnext; // list of dirty buffers, oldest first
+  int writing;      // a write from bawrite() is queued or in flight
   uchar data[BSIZE];
 };
 
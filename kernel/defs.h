@@ -2,11 +2,16 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct ioqueue;
+struct ioreq;
 struct pipe;
 struct proc;
+struct scstat;
 struct spinlock;
 struct sleeplock;
+struct rwspinlock;
 struct stat;
+struct sysinfo;
 struct superblock;
 
 // bio.c
@@ -16,6 +21,18 @@ void            brelse(struct buf*);
 void            bwrite(struct buf*);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
+int             breclaim(void);
+void            breada(uint, uint);
+void            bdone(struct buf*);
+void            bawrite(struct buf*);
+void            bwait(struct buf*);
+void            bsubmit(void);
+void            bdirty(struct buf*);
+void            bflush(uint);
+void            bsync(void);
+int             bundirty(struct buf*);
+void            flusher(void);
+int             bcachesize(void);
 
 // console.c
 void            consoleinit(void);
@@ -33,6 +50,7 @@ void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
+int             filewritek(struct file*, char*, int);
 
 // fs.c
 void            fsinit(int);
@@ -42,6 +60,8 @@ struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit();
 void            ilock(struct inode*);
+void            ilockread(struct inode*);
+void            iunlockread(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
 void            iunlockput(struct inode*);
@@ -50,6 +70,7 @@ int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, int, uint64, uint, uint);
+void            ireadahead(struct inode*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
 void            itrunc(struct inode*);
@@ -59,23 +80,36 @@ void            ramdiskinit(void);
 void            ramdiskintr(void);
 void            ramdiskrw(struct buf*);
 
+// futex.c
+void            futexinit(void);
+int             futex_wait(uint64, uint);
+int             futex_wake(uint64, int);
+
+// iosched.c
+void            ioq_init(struct ioqueue*);
+void            ioq_add(struct ioqueue*, struct buf*, int, int);
+int             ioq_next(struct ioqueue*, struct ioreq*, int);
+int             iosched_set(int);
+
 // kalloc.c
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
 int             freemem_num(void);
+int             kfreepages(void);
 
 // log.c
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
 void            begin_op(void);
 void            end_op(void);
+void            log_checkpoint(uint);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
-int             pipewrite(struct pipe*, uint64, int);
+int             pipewrite(struct pipe*, int, uint64, int);
 
 // printf.c
 void            printf(char*, ...);
@@ -86,9 +120,12 @@ void            printfinit(void);
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
+int             clone(uint64, uint64, uint64);
+int             join(int, uint64);
 int             growproc(int);
 pagetable_t     proc_pagetable(struct proc *);
-void            proc_freepagetable(pagetable_t, uint64);
+void            proc_freepagetable(pagetable_t, uint64, int);
+int             proc_pagetable_refs(pagetable_t);
 int             kill(int);
 struct cpu*     mycpu(void);
 struct cpu*     getmycpu(void);
@@ -99,13 +136,44 @@ void            sched(void);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
-int             wait(uint64);
+void            kthread(void (*)(void), char*);
+int             wait(uint64, uint64);
+int             getrusage(int, uint64);
 void            wakeup(void*);
+int             wakeupn(void*, int);
+int             sched_setaffinity(int, uint64);
+uint64          sched_getaffinity(int);
+int             schedstat(int, uint64);
+int             sched_setrt(int, int, int, int);
+void            sched_tick(void);
 void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
 int             nproc_num(void);
+void            loadtick(void);
+void            cputick(void);
+void            cpustat(int, uint64);
+void            procinfo(struct sysinfo*);
+
+// events that harts count with cpustat(), for sysinfo().
+enum { CS_BHIT, CS_BMISS, CS_DISKREAD, CS_DISKWRITE, CS_LOGCOMMIT,
+       CS_PIPEREAD, CS_PIPEWRITE, CS_READAHEAD, CS_DISKREQ,
+       CS_DISKINTR, CS_DISKNOTIFY, NCPUSTAT };
+
+// ring.c
+void            ringinit(void);
+uint64          ring_setup(void);
+int             ring_enter(int);
+void            ringfree(pagetable_t);
+
+// scstat.c
+void            scstat_record(struct proc*, int, uint64, uint64);
+int             scprofile(int);
+int             scstat_fork(struct proc*, struct proc*);
+void            scstat_reap(struct proc*, struct proc*);
+void            scstat_free(struct proc*);
+int             scstat_read(int, uint64);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -117,12 +185,25 @@ void            initlock(struct spinlock*, char*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
+void            freelock(struct spinlock*);
+void            sleeplocklink(struct sleeplock*);
+void            sleeplockunlink(struct sleeplock*);
+int             lockstat(uint64, int);
+void            initrwlock(struct rwspinlock*, char*);
+void            acquireread(struct rwspinlock*);
+void            releaseread(struct rwspinlock*);
+void            acquirewrite(struct rwspinlock*);
+void            releasewrite(struct rwspinlock*);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
+void            acquiresleepread(struct sleeplock*);
+void            releasesleepread(struct sleeplock*);
+int             holdingsleepread(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
+void            freesleeplock(struct sleeplock*);
 
 // string.c
 int             memcmp(const void*, const void*, uint);
@@ -140,6 +221,16 @@ int             argaddr(int, uint64 *);
 int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
+uint64          ringsyscall(int, uint64*);
+
+// trace.c
+void            traceinit(void);
+void            tracesyscall(struct proc*, int, uint64*, uint64);
+int             traceread(uint64, int);
+void            tracedetach(struct proc*);
+int             tracectl(uint64);
+void            tracemask(uint64);
+void            tracefork(struct proc*, struct proc*);
 
 // trap.c
 extern uint     ticks;
@@ -183,6 +274,10 @@ void            plic_complete(int);
 // virtio_disk.c
 void            virtio_disk_init(void);
 void            virtio_disk_rw(struct buf *, int);
+void            virtio_disk_start(struct buf *, int);
+void            virtio_disk_wait(struct buf *);
+void            virtio_disk_kick(void);
+int             virtio_disk_ctl(int, int);
 void            virtio_disk_intr(void);
 
 // number of elements in fixed-size array
@@ -0,0 +1,11 @@
+// diskctl(cmd, arg) sets one of the disk driver's knobs to
+// arg and returns its old value. An arg of -1 only reads it.
+
+#define DISK_POLL  1  // microseconds a waiter for a block spins on
+                      // the used ring before it sleeps; 0 is off
+#define DISK_COALESCE 2  // 1 to use event indexes to skip notifies
+                         // and interrupts while the disk is busy
+#define DISK_SCHED 3  // the I/O scheduler policy, one of:
+
+#define IOSCHED_NOOP     0  // first come, first served
+#define IOSCHED_DEADLINE 1  // elevator; reads first; deadlines
@@ -21,6 +21,10 @@ exec(char *path, char **argv)
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
 
+  // other threads are still running in the old image.
+  if(proc_pagetable_refs(p->pagetable) > 1)
+    return -1;
+
   begin_op();
 
   if((ip = namei(path)) == 0){
@@ -111,16 +115,17 @@ exec(char *path, char **argv)
   // Commit to the user image.
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
+  p->usyscall = (struct usyscall *)walkaddr(pagetable, USYSCALL);
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
-  proc_freepagetable(oldpagetable, oldsz);
+  proc_freepagetable(oldpagetable, oldsz, p->tslot);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
 
  bad:
   if(pagetable)
-    proc_freepagetable(pagetable, sz);
+    proc_freepagetable(pagetable, sz, p->tslot);
   if(ip){
     iunlockput(ip);
     end_op();
@@ -22,7 +22,11 @@ struct {
 void
 fileinit(void)
 {
+  struct file *f;
+
   initlock(&ftable.lock, "ftable");
+  for(f = ftable.file; f < ftable.file + NFILE; f++)
+    initsleeplock(&f->offlock, "file");
 }
 
 // Allocate a file structure.
@@ -101,6 +105,46 @@ filestat(struct file *f, uint64 addr)
   return -1;
 }
 
+// Sequential read-ahead for f, which has just read n bytes
+// at off. A read that starts where the last one ended grows
+// the window, up to RAMAX blocks; any other read shuts it.
+// Blocks up to a window past the end of the read are started
+// unless they were already. Caller holds f->ip->lock.
+#define RAMIN 4
+#define RAMAX 32
+
+static void
+readahead(struct file *f, uint off, int n)
+{
+  uint next = off + n, end, max;
+
+  if(f->rawin < 0)
+    return;
+  if(off != f->ranext){
+    f->rawin = 0;
+    f->raend = 0;
+    f->ranext = next;
+    return;
+  }
+  f->ranext = next;
+
+  // don't let one file flood a small buffer cache.
+  max = bcachesize() / 4;
+  if(max > RAMAX)
+    max = RAMAX;
+  f->rawin = f->rawin == 0 ? RAMIN : f->rawin * 2;
+  if(f->rawin > max)
+    f->rawin = max;
+
+  end = next / BSIZE + f->rawin;
+  if(f->raend < next / BSIZE)
+    f->raend = next / BSIZE;
+  if(f->raend < end){
+    ireadahead(f->ip, f->raend, end - f->raend);
+    f->raend = end;
+  }
+}
+
 // Read from file f.
 // addr is a user virtual address.
 int
@@ -118,10 +162,16 @@ fileread(struct file *f, uint64 addr, int n)
       return -1;
     r = devsw[f->major].read(1, addr, n);
   } else if(f->type == FD_INODE){
-    ilock(f->ip);
-    if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
+    // the inode lock is shared with other readers, so
+    // f->offlock keeps reads through f in order.
+    acquiresleep(&f->offlock);
+    ilockread(f->ip);
+    if((r = readi(f->ip, 1, addr, f->off, n)) > 0){
+      readahead(f, f->off, r);
       f->off += r;
-    iunlock(f->ip);
+    }
+    iunlockread(f->ip);
+    releasesleep(&f->offlock);
   } else {
     panic("fileread");
   }
@@ -129,10 +179,10 @@ fileread(struct file *f, uint64 addr, int n)
   return r;
 }
 
-// Write to file f.
-// addr is a user virtual address.
-int
-filewrite(struct file *f, uint64 addr, int n)
+// Write to file f from addr, a user virtual address
+// if user_src is 1, or a kernel address if it is 0.
+static int
+dowrite(struct file *f, int user_src, uint64 addr, int n)
 {
   int r, ret = 0;
 
@@ -140,11 +190,11 @@ filewrite(struct file *f, uint64 addr, int n)
     return -1;
 
   if(f->type == FD_PIPE){
-    ret = pipewrite(f->pipe, addr, n);
+    ret = pipewrite(f->pipe, user_src, addr, n);
   } else if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].write)
       return -1;
-    ret = devsw[f->major].write(1, addr, n);
+    ret = devsw[f->major].write(user_src, addr, n);
   } else if(f->type == FD_INODE){
     // write a few blocks at a time to avoid exceeding
     // the maximum log transaction size, including
@@ -161,7 +211,7 @@ filewrite(struct file *f, uint64 addr, int n)
 
       begin_op();
       ilock(f->ip);
-      if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
+      if ((r = writei(f->ip, user_src, addr + i, f->off, n1)) > 0)
         f->off += r;
       iunlock(f->ip);
       end_op();
@@ -180,3 +230,18 @@ filewrite(struct file *f, uint64 addr, int n)
   return ret;
 }
 
+// Write to file f.
+// addr is a user virtual address.
+int
+filewrite(struct file *f, uint64 addr, int n)
+{
+  return dowrite(f, 1, addr, n);
+}
+
+// Write n bytes from kernel memory at src to file f.
+int
+filewritek(struct file *f, char *src, int n)
+{
+  return dowrite(f, 0, (uint64)src, n);
+}
+
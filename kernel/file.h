@@ -6,6 +6,10 @@ struct file {
   struct pipe *pipe; // FD_PIPE
   struct inode *ip;  // FD_INODE and FD_DEVICE
   uint off;          // FD_INODE
+  struct sleeplock offlock; // FD_INODE: serializes reads of off
+  uint ranext;       // FD_INODE: where a sequential read would start
+  uint raend;        // FD_INODE: blocks before this were read ahead
+  int rawin;         // FD_INODE: read-ahead window in blocks, -1 if off
   short major;       // FD_DEVICE
 };
 
@@ -142,7 +142,9 @@ bfree(int dev, uint b)
 //
 // * Locked: file system code may only examine and modify
 //   the information in an inode and its content if it
-//   has first locked the inode.
+//   has first locked the inode. Code that only reads,
+//   like read() and path lookup, can use ilockread()
+//   instead, which lets other readers in at the same time.
 //
 // Thus a typical sequence is:
 //   ip = iget(dev, inum)
@@ -162,17 +164,21 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The icache.lock spin-lock protects the allocation of icache
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
+// The icache.lock reader-writer spin-lock protects the allocation
+// of icache entries. Since ip->ref indicates whether an entry is
+// free, and ip->dev and ip->inum indicate which i-node an entry
 // holds, one must hold icache.lock while using any of those fields.
+// Most iget()s find the inode already cached, so looking an entry
+// up and taking a reference only needs the lock shared, with ref
+// incremented atomically; claiming an entry and dropping
+// references (iput) need it exclusively.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
 struct {
-  struct spinlock lock;
+  struct rwspinlock lock;
   struct inode inode[NINODE];
 } icache;
 
@@ -181,7 +187,7 @@ iinit()
 {
   int i = 0;
   
-  initlock(&icache.lock, "icache");
+  initrwlock(&icache.lock, "icache");
   for(i = 0; i < NINODE; i++) {
     initsleeplock(&icache.inode[i].lock, "inode");
   }
@@ -236,6 +242,26 @@ iupdate(struct inode *ip)
   brelse(bp);
 }
 
+// Look for a cached copy of inode inum on device dev, and
+// take a reference to it. If there is none, set *empty to
+// a free entry, if any. Caller must hold icache.lock.
+static struct inode*
+icachefind(uint dev, uint inum, struct inode **empty)
+{
+  struct inode *ip;
+
+  *empty = 0;
+  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
+    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
+      __sync_fetch_and_add(&ip->ref, 1);
+      return ip;
+    }
+    if(*empty == 0 && ip->ref == 0)    // Remember empty slot.
+      *empty = ip;
+  }
+  return 0;
+}
+
 // Find the inode with number inum on device dev
 // and return the in-memory copy. Does not lock
 // the inode and does not read it from disk.
@@ -244,18 +270,19 @@ iget(uint dev, uint inum)
 {
   struct inode *ip, *empty;
 
-  acquire(&icache.lock);
-
   // Is the inode already cached?
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
-      release(&icache.lock);
-      return ip;
-    }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
+  acquireread(&icache.lock);
+  ip = icachefind(dev, inum, &empty);
+  releaseread(&icache.lock);
+  if(ip)
+    return ip;
+
+  // Look again with the lock held exclusively, since
+  // another process may have cached it in the meantime.
+  acquirewrite(&icache.lock);
+  if((ip = icachefind(dev, inum, &empty)) != 0){
+    releasewrite(&icache.lock);
+    return ip;
   }
 
   // Recycle an inode cache entry.
@@ -267,7 +294,7 @@ iget(uint dev, uint inum)
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
-  release(&icache.lock);
+  releasewrite(&icache.lock);
 
   return ip;
 }
@@ -277,9 +304,9 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&icache.lock);
-  ip->ref++;
-  release(&icache.lock);
+  acquireread(&icache.lock);
+  __sync_fetch_and_add(&ip->ref, 1);
+  releaseread(&icache.lock);
   return ip;
 }
 
@@ -322,6 +349,38 @@ iunlock(struct inode *ip)
   releasesleep(&ip->lock);
 }
 
+// Lock the given inode shared, for callers that only read
+// it and its content. Other readers may hold it too.
+// Reads the inode from disk if necessary.
+void
+ilockread(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("ilockread");
+
+  acquiresleepread(&ip->lock);
+
+  if(ip->valid == 0){
+    // reading the inode in writes its fields, which takes
+    // the lock exclusively. it stays valid afterwards,
+    // since we hold a reference.
+    releasesleepread(&ip->lock);
+    ilock(ip);
+    iunlock(ip);
+    acquiresleepread(&ip->lock);
+  }
+}
+
+// Unlock an inode locked with ilockread().
+void
+iunlockread(struct inode *ip)
+{
+  if(ip == 0 || !holdingsleepread(&ip->lock) || ip->ref < 1)
+    panic("iunlockread");
+
+  releasesleepread(&ip->lock);
+}
+
 // Drop a reference to an in-memory inode.
 // If that was the last reference, the inode cache entry can
 // be recycled.
@@ -332,7 +391,7 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
-  acquire(&icache.lock);
+  acquirewrite(&icache.lock);
 
   if(ip->ref == 1 && ip->valid && ip->nlink == 0){
     // inode has no links and no other references: truncate and free.
@@ -341,7 +400,7 @@ iput(struct inode *ip)
     // so this acquiresleep() won't block (or deadlock).
     acquiresleep(&ip->lock);
 
-    release(&icache.lock);
+    releasewrite(&icache.lock);
 
     itrunc(ip);
     ip->type = 0;
@@ -350,11 +409,11 @@ iput(struct inode *ip)
 
     releasesleep(&ip->lock);
 
-    acquire(&icache.lock);
+    acquirewrite(&icache.lock);
   }
 
   ip->ref--;
-  release(&icache.lock);
+  releasewrite(&icache.lock);
 }
 
 // Common idiom: unlock, then put.
@@ -449,7 +508,9 @@ stati(struct inode *ip, struct stat *st)
 }
 
 // Read data from inode.
-// Caller must hold ip->lock.
+// Caller must hold ip->lock, shared or exclusive. Shared is
+// enough because files have no holes (writei() never writes
+// past the end), so bmap() won't allocate anything here.
 // If user_dst==1, then dst is a user virtual address;
 // otherwise, dst is a kernel address.
 int
@@ -475,6 +536,21 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
   return tot;
 }
 
+// Start reading n blocks of ip's content from block bn on
+// into the buffer cache, stopping at the end of the file.
+// The reads are queued together, so that blocks that are
+// adjacent on the disk go to it as one request.
+// Caller must hold ip->lock, shared or exclusive.
+void
+ireadahead(struct inode *ip, uint bn, uint n)
+{
+  uint end = (ip->size + BSIZE - 1) / BSIZE;
+
+  for(; n > 0 && bn < end; bn++, n--)
+    breada(ip->dev, bmap(ip, bn));
+  bsubmit();
+}
+
 // Write data to inode.
 // Caller must hold ip->lock.
 // If user_src==1, then src is a user virtual address;
@@ -523,6 +599,7 @@ namecmp(const char *s, const char *t)
 
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
+// Caller must hold dp->lock, shared or exclusive.
 struct inode*
 dirlookup(struct inode *dp, char *name, uint *poff)
 {
@@ -627,27 +704,35 @@ namex(char *path, int nameiparent, char *name)
 {
   struct inode *ip, *next;
 
-  if(*path == '/')
+  if(*path == '/'){
     ip = iget(ROOTDEV, ROOTINO);
-  else
-    ip = idup(myproc()->cwd);
+  } else {
+    // another thread may chdir() meanwhile.
+    struct fdtable *t = myproc()->fdt;
+    acquire(&t->lock);
+    ip = idup(t->cwd);
+    release(&t->lock);
+  }
 
+  // lookups only read the directories, so any number of
+  // them can walk the same directory at once.
   while((path = skipelem(path, name)) != 0){
-    ilock(ip);
+    ilockread(ip);
     if(ip->type != T_DIR){
-      iunlockput(ip);
+      iunlockread(ip);
+      iput(ip);
       return 0;
     }
     if(nameiparent && *path == '\0'){
       // Stop one level early.
-      iunlock(ip);
+      iunlockread(ip);
       return ip;
     }
-    if((next = dirlookup(ip, name, 0)) == 0){
-      iunlockput(ip);
+    next = dirlookup(ip, name, 0);
+    iunlockread(ip);
+    iput(ip);
+    if(next == 0)
       return 0;
-    }
-    iunlockput(ip);
     ip = next;
   }
   if(nameiparent){
@@ -0,0 +1,82 @@
+//
+// Futexes: sleep until a word of user memory changes.
+//
+// Waiters sleep on the physical address of the word, so
+// threads that share a page table, or any other mapping of
+// the same page, meet on the same channel.
+// User code only calls futex_wait() after it sees the word
+// is contended, so uncontended locks never trap.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "proc.h"
+
+struct {
+  struct spinlock lock;
+} futex;
+
+void
+futexinit(void)
+{
+  initlock(&futex.lock, "futex");
+}
+
+// Return the physical address of the aligned user word
+// at addr, or 0 if it is not mapped.
+static uint64
+futexaddr(uint64 addr)
+{
+  struct proc *p = myproc();
+  uint64 pa;
+
+  if(addr % sizeof(uint) != 0 || addr >= p->sz)
+    return 0;
+  if((pa = walkaddr(p->pagetable, PGROUNDDOWN(addr))) == 0)
+    return 0;
+  return pa + (addr - PGROUNDDOWN(addr));
+}
+
+// Sleep until woken by futex_wake(), but only if the
+// word at addr still holds val.
+// Returns 0 when woken, -1 if the word had changed
+// or the arguments are bad.
+int
+futex_wait(uint64 addr, uint val)
+{
+  uint64 pa;
+
+  if((pa = futexaddr(addr)) == 0)
+    return -1;
+
+  // holding futex.lock while checking the word means a
+  // futex_wake() issued after the word changed can't be missed.
+  acquire(&futex.lock);
+  if(*(volatile uint *)pa != val || myproc()->killed){
+    release(&futex.lock);
+    return -1;
+  }
+  sleep((void*)pa, &futex.lock);
+  release(&futex.lock);
+  return 0;
+}
+
+// Wake up at most n processes waiting on the word at addr.
+// Returns the number woken, or -1 for a bad address.
+int
+futex_wake(uint64 addr, int n)
+{
+  uint64 pa;
+  int woken;
+
+  if((pa = futexaddr(addr)) == 0)
+    return -1;
+
+  acquire(&futex.lock);
+  woken = wakeupn((void*)pa, n);
+  release(&futex.lock);
+  return woken;
+}
@@ -0,0 +1,170 @@
+// I/O scheduler.
+//
+// Block operations wait in an ioqueue on their way to the disk.
+// When the driver has room, it asks ioq_next() for the next run
+// of operations: adjacent blocks going the same way, which it
+// sends as one request. The scheduler policy picks the
+// operation the run is built around:
+//
+// * noop takes the oldest operation, in the order they came.
+//
+// * deadline sweeps across the disk in one direction, so the
+//   head moves little between runs, and prefers reads, which
+//   processes wait for, to writes, which are mostly the
+//   flusher's. Writes still go after WRITESTARVE runs of reads,
+//   and any operation older than its deadline goes first.
+//
+// The caller serializes access to each ioqueue.
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "iosched.h"
+#include "diskctl.h"
+
+#define READEXPIRE  (CLINT_FREQ / 20)  // 50ms
+#define WRITEEXPIRE (CLINT_FREQ / 2)   // 500ms
+#define WRITESTARVE 2
+
+static int policy = IOSCHED_DEADLINE;
+
+// index of the oldest operation going the way of write, or
+// of any if write is -1; -1 if there is none.
+static int
+oldest(struct ioqueue *q, int write)
+{
+  int i, o = -1;
+
+  for(i = 0; i < q->n; i++){
+    if(write >= 0 && q->req[i].write != write)
+      continue;
+    if(o < 0 || q->req[i].time < q->req[o].time)
+      o = i;
+  }
+  return o;
+}
+
+// index of the next operation going the way of write at or
+// past the sweep's position, wrapping to the lowest block at
+// the end of the disk; -1 if there is none.
+static int
+sweep(struct ioqueue *q, int write)
+{
+  int i, first = -1;
+
+  for(i = 0; i < q->n; i++){
+    if(q->req[i].write != write)
+      continue;
+    if(q->req[i].b->blockno >= q->pos)
+      return i;
+    if(first < 0)
+      first = i;
+  }
+  return first;
+}
+
+static int
+pick_noop(struct ioqueue *q)
+{
+  return oldest(q, -1);
+}
+
+static int
+pick_deadline(struct ioqueue *q)
+{
+  uint64 now = r_time();
+  int r = oldest(q, 0);
+  int w = oldest(q, 1);
+
+  if(r >= 0 && now - q->req[r].time > READEXPIRE)
+    return r;
+  if(w >= 0 && now - q->req[w].time > WRITEEXPIRE)
+    return w;
+  if(r >= 0 && (w < 0 || q->starved < WRITESTARVE)){
+    if(w >= 0)
+      q->starved++;
+    return sweep(q, 0);
+  }
+  q->starved = 0;
+  return sweep(q, 1);
+}
+
+// each policy returns the index of the next operation.
+static int (*scheds[])(struct ioqueue*) = {
+[IOSCHED_NOOP]     pick_noop,
+[IOSCHED_DEADLINE] pick_deadline,
+};
+
+void
+ioq_init(struct ioqueue *q)
+{
+  q->n = 0;
+  q->pos = 0;
+  q->starved = 0;
+}
+
+// Add an operation on b to q, which must not be full.
+void
+ioq_add(struct ioqueue *q, struct buf *b, int write, int async)
+{
+  int i;
+
+  if(q->n == NIOREQ)
+    panic("ioq_add");
+  for(i = q->n; i > 0 && q->req[i-1].b->blockno > b->blockno; i--)
+    q->req[i] = q->req[i-1];
+  q->req[i].b = b;
+  q->req[i].write = write;
+  q->req[i].async = async;
+  q->req[i].time = r_time();
+  q->n++;
+}
+
+// Take the next run of at most max operations out of q, into
+// run[], in block order. Returns its length, or 0 if q is empty.
+int
+ioq_next(struct ioqueue *q, struct ioreq *run, int max)
+{
+  int lo, hi, n;
+
+  if(q->n == 0)
+    return 0;
+  lo = hi = scheds[policy](q);
+
+  // q is sorted, so any adjacent blocks are next to each other.
+  while(hi - lo + 1 < max && hi + 1 < q->n &&
+        q->req[hi+1].write == q->req[hi].write &&
+        q->req[hi+1].b->blockno == q->req[hi].b->blockno + 1)
+    hi++;
+  while(hi - lo + 1 < max && lo > 0 &&
+        q->req[lo-1].write == q->req[lo].write &&
+        q->req[lo-1].b->blockno + 1 == q->req[lo].b->blockno)
+    lo--;
+
+  n = hi - lo + 1;
+  memmove(run, &q->req[lo], n * sizeof(run[0]));
+  memmove(&q->req[lo], &q->req[hi+1], (q->n - hi - 1) * sizeof(q->req[0]));
+  q->n -= n;
+  q->pos = run[n-1].b->blockno + 1;
+  return n;
+}
+
+// Switch every queue to policy p, from diskctl.h, unless p is
+// -1, and return the old one, or -1 if there is no policy p.
+int
+iosched_set(int p)
+{
+  int old = policy;
+
+  if(p < -1 || p >= NELEM(scheds))
+    return -1;
+  if(p >= 0)
+    policy = p;
+  return old;
+}
@@ -0,0 +1,18 @@
+// Block operations waiting for the disk, and the I/O scheduler
+// that picks which go next. See iosched.c.
+
+#define NIOREQ 128  // operations a queue holds
+
+struct ioreq {
+  struct buf *b;
+  char write;
+  char async;    // read-ahead or write-back; nobody waits yet
+  uint64 time;   // r_time() when queued
+};
+
+struct ioqueue {
+  struct ioreq req[NIOREQ];  // sorted by block number
+  int n;
+  uint pos;      // block just past the last run handed out
+  int starved;   // runs of reads picked while writes waited
+};
@@ -21,8 +21,17 @@ struct run {
 struct {
   struct spinlock lock;
   struct run *freelist;
+  int nfree;              // pages on freelist
 } kmem;
 
+// Caches that can give pages back when the free list runs
+// dry. Each frees what it can spare and returns how many
+// pages that was. kalloc() may be called with any lock but
+// kmem.lock held, so these must cope with that.
+static int (*reclaim[])(void) = {
+  breclaim,   // buffer cache
+};
+
 void
 kinit()
 {
@@ -59,6 +68,7 @@ kfree(void *pa)
   acquire(&kmem.lock);
   r->next = kmem.freelist;
   kmem.freelist = r;
+  kmem.nfree++;
   release(&kmem.lock);
 }
 
@@ -69,24 +79,37 @@ void *
 kalloc(void)
 {
   struct run *r;
+  int i, n;
 
-  acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
-  release(&kmem.lock);
+  for(;;){
+    acquire(&kmem.lock);
+    r = kmem.freelist;
+    if(r){
+      kmem.freelist = r->next;
+      kmem.nfree--;
+    }
+    release(&kmem.lock);
+    if(r)
+      break;
+
+    // out of memory: ask the caches for some back.
+    for(i = n = 0; i < NELEM(reclaim); i++)
+      n += reclaim[i]();
+    if(n == 0)
+      break;
+  }
 
   if(r)
     memset((char*)r, 5, PGSIZE); // fill with junk
   return (void*)r;
 }
 int freemem_num(){
-  struct run *r;
-  int num =0;
-   r = kmem.freelist;
-   while(r){
-     num++;
-     r = r->next;
-   }
-   return num*PGSIZE;
-}
\ No newline at end of file
+   return kfreepages()*PGSIZE;
+}
+
+// Number of free pages.
+int
+kfreepages(void)
+{
+  return kmem.nfree;
+}
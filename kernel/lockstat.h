@@ -0,0 +1,17 @@
+// Contention statistics for one lock, as returned by
+// lockstat(). Times are in CLINT_FREQ cycles.
+struct lockstat {
+  char name[16];
+  uint64 id;          // Kernel address of the lock
+  int kind;           // LOCK_SPIN, LOCK_SLEEP or LOCK_RW
+  uint64 nacquire;    // Times acquired
+  uint64 ncontend;    // Times the acquirer had to wait
+  uint64 wait;        // Total time spent waiting
+  uint64 maxhold;     // Longest time held
+  uint64 nspin;       // Sleep locks: waits that only spun
+  uint64 nsleep;      // Sleep locks: waits that slept
+};
+
+#define LOCK_SPIN   0   // struct spinlock
+#define LOCK_SLEEP  1   // struct sleeplock
+#define LOCK_RW     2   // struct rwspinlock
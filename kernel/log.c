@@ -28,7 +28,17 @@
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+// Log appends are written concurrently, and commit waits for
+// them all before writing the header. Installing a committed
+// transaction only marks its blocks dirty; the flusher thread
+// (or the next commit) writes them home, and only then erases
+// the header so that the log can be reused.
+//
+// A block of that live transaction may be changed again by the
+// next one before it gets home. Its buffer then no longer holds
+// what was committed, so log_write() takes it off the dirty
+// list, and the checkpoint copies the committed contents home
+// from the live transaction's log block instead.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
@@ -45,11 +55,26 @@ struct log {
   int committing;  // in commit(), please wait.
   int dev;
   struct logheader lh;
+
+  // Held by commit() and log_checkpoint(). live says that
+  // the header on disk still describes the last transaction,
+  // whose blocks may not all be home yet.
+  struct sleeplock cplock;
+  int live;
+  uint committed;  // ticks when the live transaction committed
+  struct logheader livelh;  // the live transaction's blocks
+  char stale[LOGSIZE];      // livelh blocks to copy home from
+                            // the log; protected by lock
 };
 struct log log;
 
+// for copying a block from the log to its home, without
+// disturbing the cached copy of either.
+static struct buf copybuf;
+
 static void recover_from_log(void);
 static void commit();
+static void write_head(int n);
 
 void
 initlog(int dev, struct superblock *sb)
@@ -58,29 +83,91 @@ initlog(int dev, struct superblock *sb)
     panic("initlog: too big logheader");
 
   initlock(&log.lock, "log");
+  initsleeplock(&log.cplock, "log.checkpoint");
   log.start = sb->logstart;
   log.size = sb->nlog;
   log.dev = dev;
   recover_from_log();
+
+  // now there is a log for the flusher to checkpoint.
+  kthread(flusher, "flusher");
 }
 
-// Copy committed blocks from log to their home location
+// Copy committed blocks from log to their home location.
+// When recovering, write them there now. After a commit,
+// the cached blocks already hold the data, so just leave
+// them dirty for the flusher.
 static void
-install_trans(void)
+install_trans(int recovering)
 {
   int tail;
 
   for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
     struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    bunpin(dbuf);
-    brelse(lbuf);
+    if (recovering) {
+      struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
+      memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
+      bwrite(dbuf);  // write dst to disk
+      brelse(lbuf);
+    } else {
+      bdirty(dbuf);
+      bunpin(dbuf);  // the dirty buffer keeps its own reference
+    }
     brelse(dbuf);
   }
 }
 
+// Write the live transaction's blocks that log_write() found
+// changed again home, from their log blocks.
+static void
+copy_stale(void)
+{
+  int tail, stale;
+
+  for (tail = 0; tail < log.livelh.n; tail++) {
+    acquire(&log.lock);
+    stale = log.stale[tail];
+    log.stale[tail] = 0;
+    release(&log.lock);
+    if (!stale)
+      continue;
+    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
+    copybuf.dev = log.dev;
+    copybuf.blockno = log.livelh.block[tail];
+    memmove(copybuf.data, lbuf->data, BSIZE);
+    brelse(lbuf);
+    virtio_disk_rw(&copybuf, 1);
+  }
+}
+
+// If the last transaction is still live, write its blocks
+// home and erase it from the log. Its blocks' write-backs may
+// have been started by others, or queued behind later I/O, so
+// wait for every write before the header goes. Caller holds
+// log.cplock.
+static void
+checkpoint(void)
+{
+  if (!log.live)
+    return;
+  bflush(0);
+  copy_stale();
+  bsync();
+  write_head(0);
+  log.live = 0;
+}
+
+// Called by the flusher: checkpoint the live transaction
+// once it has been committed for minage ticks.
+void
+log_checkpoint(uint minage)
+{
+  acquiresleep(&log.cplock);
+  if (log.live && ticks - log.committed >= minage)
+    checkpoint();
+  releasesleep(&log.cplock);
+}
+
 // Read the log header from disk into the in-memory log header
 static void
 read_head(void)
@@ -95,17 +182,17 @@ read_head(void)
   brelse(buf);
 }
 
-// Write in-memory log header to disk.
+// Write in-memory log header, with its first n blocks, to disk.
 // This is the true point at which the
 // current transaction commits.
 static void
-write_head(void)
+write_head(int n)
 {
   struct buf *buf = bread(log.dev, log.start);
   struct logheader *hb = (struct logheader *) (buf->data);
   int i;
-  hb->n = log.lh.n;
-  for (i = 0; i < log.lh.n; i++) {
+  hb->n = n;
+  for (i = 0; i < n; i++) {
     hb->block[i] = log.lh.block[i];
   }
   bwrite(buf);
@@ -116,9 +203,9 @@ static void
 recover_from_log(void)
 {
   read_head();
-  install_trans(); // if committed, copy from log to disk
+  install_trans(1); // if committed, copy from log to disk
   log.lh.n = 0;
-  write_head(); // clear the log
+  write_head(0); // clear the log
 }
 
 // called at the start of each FS system call.
@@ -173,19 +260,24 @@ end_op(void)
   }
 }
 
-// Copy modified blocks from cache to log.
+// Copy modified blocks from cache to log. The writes are
+// started one after another and waited for together.
 static void
 write_log(void)
 {
+  struct buf *to[LOGSIZE];
   int tail;
 
   for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
+    to[tail] = bread(log.dev, log.start+tail+1); // log block
     struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
+    memmove(to[tail]->data, from->data, BSIZE);
+    bawrite(to[tail]);  // start writing the log
     brelse(from);
-    brelse(to);
+  }
+  for (tail = 0; tail < log.lh.n; tail++) {
+    bwait(to[tail]);
+    brelse(to[tail]);
   }
 }
 
@@ -193,11 +285,17 @@ static void
 commit()
 {
   if (log.lh.n > 0) {
+    acquiresleep(&log.cplock);
+    checkpoint();    // Finish the last transaction, to reuse the log
     write_log();     // Write modified blocks from cache to log
-    write_head();    // Write header to disk -- the real commit
-    install_trans(); // Now install writes to home locations
+    write_head(log.lh.n); // Write header to disk -- the real commit
+    install_trans(0); // Leave the blocks for the flusher to write home
+    memmove(&log.livelh, &log.lh, sizeof(log.lh));
+    log.live = 1;
+    log.committed = ticks;
     log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
+    releasesleep(&log.cplock);
+    cpustat(CS_LOGCOMMIT, 1);
   }
 }
 
@@ -230,6 +328,17 @@ log_write(struct buf *b)
     bpin(b);
     log.lh.n++;
   }
+  // b is dirty if the live transaction wrote it and it isn't
+  // home yet. log.lock keeps a checkpoint from finishing
+  // between here and marking it stale.
+  if (bundirty(b)) {
+    for (i = 0; i < log.livelh.n; i++)
+      if (log.livelh.block[i] == b->blockno)
+        break;
+    if (!log.live || i == log.livelh.n)
+      panic("log_write: dirty");
+    log.stale[i] = 1;
+  }
   release(&log.lock);
 }
 
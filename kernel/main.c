@@ -27,6 +27,9 @@ main()
     binit();         // buffer cache
     iinit();         // inode cache
     fileinit();      // file table
+    futexinit();     // futex wait queues
+    traceinit();     // syscall trace rings
+    ringinit();      // syscall submission rings
     virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
     __sync_synchronize();
@@ -29,6 +29,8 @@
 #define CLINT 0x2000000L
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
+#define CLINT_FREQ 10000000 // CLINT_MTIME cycles per second in qemu.
+#define CLINT_INTERVAL 1000000 // cycles per clock tick; about 1/10th second.
 
 // qemu puts programmable interrupt controller here.
 #define PLIC 0x0c000000L
@@ -62,6 +64,21 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   RING (ring_setup()'s submission ring, if any)
+//   USYSCALL (struct usyscall, read-only to the process)
+//   THREADFRAME(NTHREAD-1) .. THREADFRAME(1) (clone()d threads)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+
+// threads created by clone() share a page table, so each one
+// needs its own trapframe page. thread slot t's trapframe is
+// mapped at THREADFRAME(t); slot 0 is the usual TRAPFRAME.
+#define THREADFRAME(t) (TRAPFRAME - (t)*PGSIZE)
+
+// data the kernel shares with user space so that ulib.c can
+// answer getpid() and uptime() without a trap. see usyscall.h.
+#define USYSCALL (TRAPFRAME - NTHREAD*PGSIZE)
+
+// a process's system call submission ring. see ring.c.
+#define RING (USYSCALL - PGSIZE)
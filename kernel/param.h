@@ -1,6 +1,8 @@
 #define NPROC        64  // maximum number of processes
+#define NKPROC        1  // kernel threads, besides NPROC processes
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
+#define NTHREAD      16  // maximum threads sharing one address space
 #define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
@@ -8,6 +10,10 @@
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define NBUF         (MAXOPBLOCKS*3)  // minimum size of disk block cache
+#define BCACHEFRAC   16  // disk block cache grows to 1/BCACHEFRAC of RAM
+#define NBUCKET      127 // hash buckets in the disk block cache
+#define DIRTYAGE     3   // ticks a dirty buffer waits for write-back
+#define FSSIZE       4000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define RTUTIL        90   // percent of a hart real-time processes may reserve
@@ -5,19 +5,77 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "schedstat.h"
+#include "rusage.h"
+#include "usyscall.h"
+#include "sysinfo.h"
 
 struct cpu cpus[NCPU];
 
-struct proc proc[NPROC];
+// harts that have entered scheduler(), one bit each.
+uint64 cpus_online;
+
+// Admission control for the real-time class. util is the
+// sum of runtime/deadline over real-time processes, in
+// thousandths of a hart. lock serializes admission; util and
+// nproc are also dropped atomically by freeproc().
+struct {
+  struct spinlock lock;
+  int util;
+  int nproc;
+} rt;
+
+// A real-time process's share of rt.util. runtime is at most
+// deadline, so this is at most 1000, but runtime * 1000
+// overflows an int.
+static int
+rtutil(int runtime, int deadline)
+{
+  return (uint64)runtime * 1000 / deadline;
+}
+
+// counters for sysinfo(). each hart updates its own row of
+// cpustats, so counting needs no lock; load is updated by
+// loadtick() on hart 0.
+uint64 cpustats[NCPU][NCPUSTAT];
+struct {
+  uint64 nrunnable;
+  uint64 avg[3];
+} load;
+
+// proc[NPROC] on hold kernel threads. allocpid() does not
+// number them, and only the scheduler, wakeup() and the load
+// average look past proc[NPROC-1], so kill(), wait() and the
+// process listings never see them.
+struct proc proc[NPROC+NKPROC];
 
 struct proc *initproc;
 
 int nextpid = 1;
 struct spinlock pid_lock;
 
+// Reference counts for user page tables, which clone()
+// shares among the threads of a process. slots has a bit
+// set for each THREADFRAME in use. The lock also serializes
+// growproc() so that threads agree on the size of memory.
+struct {
+  struct spinlock lock;
+  struct {
+    pagetable_t pagetable;
+    int ref;
+    uint slots;
+  } pt[2*NPROC];
+} ptrefs;
+
+// Each process has at most one, so NPROC are enough.
+struct fdtable fdtables[NPROC];
+
 extern void forkret(void);
 static void wakeup1(struct proc *chan);
 static void freeproc(struct proc *p);
+static int sharepagetable(struct proc *np, struct proc *p);
+static struct fdtable *fdtalloc(void);
+static void fdtput(struct fdtable *t);
 
 extern char trampoline[]; // trampoline.S
 
@@ -28,7 +86,11 @@ procinit(void)
   struct proc *p;
   
   initlock(&pid_lock, "nextpid");
-  for(p = proc; p < &proc[NPROC]; p++) {
+  initlock(&ptrefs.lock, "ptrefs");
+  initlock(&rt.lock, "rt");
+  for(int i = 0; i < NPROC; i++)
+    initlock(&fdtables[i].lock, "fdtable");
+  for(p = proc; p < &proc[NPROC+NKPROC]; p++) {
       initlock(&p->lock, "proc");
 
       // Allocate a page for the process's kernel stack.
@@ -88,9 +150,11 @@ allocpid() {
 // Look in the process table for an UNUSED proc.
 // If found, initialize state required to run in the kernel,
 // and return with p->lock held.
+// If parent is non-zero, the new proc is a thread that
+// shares parent's page table; otherwise it gets its own.
 // If there are no free procs, or a memory allocation fails, return 0.
 static struct proc*
-allocproc(void)
+allocproc(struct proc *parent)
 {
   struct proc *p;
 
@@ -106,6 +170,19 @@ allocproc(void)
 
 found:
   p->pid = allocpid();
+  p->affinity = ~0L;
+  p->lastcpu = -1;
+  p->nsched = 0;
+  p->nmigrate = 0;
+  p->rt_period = 0;
+  p->rt_throttled = 0;
+  p->rt_missed = 0;
+  p->utime = p->stime = 0;
+  p->nvcsw = p->nivcsw = p->nfault = 0;
+  p->cutime = p->cstime = 0;
+  p->cnvcsw = p->cnivcsw = p->cnfault = 0;
+  p->scstat = p->cscstat = 0;
+  p->kfn = 0;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -113,14 +190,35 @@ found:
     return 0;
   }
 
-  // An empty user page table.
-  p->pagetable = proc_pagetable(p);
+  // An empty user page table, or a thread slot in parent's.
+  if(parent == 0){
+    p->tslot = 0;
+    p->pagetable = proc_pagetable(p);
+  } else if(sharepagetable(p, parent) < 0){
+    p->pagetable = 0;
+  }
   if(p->pagetable == 0){
     freeproc(p);
     release(&p->lock);
     return 0;
   }
 
+  // Open files of its own, which fork() fills in, or a
+  // share of parent's.
+  if(parent == 0){
+    if((p->fdt = fdtalloc()) == 0){
+      freeproc(p);
+      release(&p->lock);
+      return 0;
+    }
+  } else {
+    p->fdt = parent->fdt;
+    acquire(&p->fdt->lock);
+    p->fdt->ref++;
+    release(&p->fdt->lock);
+  }
+  p->usyscall = (struct usyscall *)walkaddr(p->pagetable, USYSCALL);
+
   // Set up new context to start executing at forkret,
   // which returns to user space.
   memset(&p->context, 0, sizeof(p->context));
@@ -140,9 +238,21 @@ freeproc(struct proc *p)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
   if(p->pagetable)
-    proc_freepagetable(p->pagetable, p->sz);
+    proc_freepagetable(p->pagetable, p->sz, p->tslot);
   p->pagetable = 0;
+  p->usyscall = 0;
+  p->tslot = 0;
+  p->ustack = 0;
   p->sz = 0;
+  if(p->fdt)
+    fdtput(p->fdt);
+  p->fdt = 0;
+  scstat_free(p);
+  if(p->rt_period){
+    __sync_fetch_and_sub(&rt.util, rtutil(p->rt_runtime, p->rt_deadline));
+    __sync_fetch_and_sub(&rt.nproc, 1);
+    p->rt_period = 0;
+  }
   p->pid = 0;
   p->parent = 0;
   p->name[0] = 0;
@@ -158,6 +268,7 @@ pagetable_t
 proc_pagetable(struct proc *p)
 {
   pagetable_t pagetable;
+  struct usyscall *u;
 
   // An empty page table.
   pagetable = uvmcreate();
@@ -174,27 +285,177 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
-  // map the trapframe just below TRAMPOLINE, for trampoline.S.
-  if(mappages(pagetable, TRAPFRAME, PGSIZE,
+  // map the trapframe just below TRAMPOLINE, for trampoline.S,
+  // or lower down if p is a thread.
+  if(mappages(pagetable, THREADFRAME(p->tslot), PGSIZE,
               (uint64)(p->trapframe), PTE_R | PTE_W) < 0){
     uvmunmap(pagetable, TRAMPOLINE, 1, 0);
     uvmfree(pagetable, 0);
     return 0;
   }
 
-  return pagetable;
+  // map the data that ulib.c reads instead of trapping,
+  // read-only, just below the thread trapframes.
+  if((u = (struct usyscall *)kalloc()) == 0 ||
+     mappages(pagetable, USYSCALL, PGSIZE, (uint64)u, PTE_R | PTE_U) < 0){
+    if(u)
+      kfree(u);
+    uvmunmap(pagetable, THREADFRAME(p->tslot), 1, 0);
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+  memset(u, 0, PGSIZE);
+  u->pid = p->pid;
+  u->ticks = ticks;
+  u->freq = CLINT_FREQ;
+  u->interval = CLINT_INTERVAL;
+
+  // record the reference held by p.
+  acquire(&ptrefs.lock);
+  for(int i = 0; i < NELEM(ptrefs.pt); i++){
+    if(ptrefs.pt[i].ref == 0){
+      ptrefs.pt[i].pagetable = pagetable;
+      ptrefs.pt[i].ref = 1;
+      ptrefs.pt[i].slots = 1 << p->tslot;
+      release(&ptrefs.lock);
+      return pagetable;
+    }
+  }
+  panic("proc_pagetable: ptrefs");
 }
 
-// Free a process's page table, and free the
-// physical memory it refers to.
+// Map np's trapframe into p's page table at a free thread
+// slot, and make np share that page table.
+// Returns the slot, or -1 if there is none free.
+static int
+sharepagetable(struct proc *np, struct proc *p)
+{
+  int i, t;
+
+  acquire(&ptrefs.lock);
+  for(i = 0; i < NELEM(ptrefs.pt); i++)
+    if(ptrefs.pt[i].ref > 0 && ptrefs.pt[i].pagetable == p->pagetable)
+      break;
+  if(i == NELEM(ptrefs.pt))
+    panic("sharepagetable");
+  for(t = 1; t < NTHREAD; t++)
+    if((ptrefs.pt[i].slots & (1 << t)) == 0)
+      break;
+  if(t == NTHREAD || mappages(p->pagetable, THREADFRAME(t), PGSIZE,
+                              (uint64)(np->trapframe), PTE_R | PTE_W) < 0){
+    release(&ptrefs.lock);
+    return -1;
+  }
+  ptrefs.pt[i].ref++;
+  ptrefs.pt[i].slots |= 1 << t;
+  np->pagetable = p->pagetable;
+  np->sz = p->sz;
+  np->tslot = t;
+  release(&ptrefs.lock);
+  return t;
+}
+
+// Return how many threads share pagetable.
+// Caller holds ptrefs.lock.
+static int
+ptrefcount(pagetable_t pagetable)
+{
+  for(int i = 0; i < NELEM(ptrefs.pt); i++)
+    if(ptrefs.pt[i].ref > 0 && ptrefs.pt[i].pagetable == pagetable)
+      return ptrefs.pt[i].ref;
+  return 0;
+}
+
+int
+proc_pagetable_refs(pagetable_t pagetable)
+{
+  int ref;
+
+  acquire(&ptrefs.lock);
+  ref = ptrefcount(pagetable);
+  release(&ptrefs.lock);
+  return ref;
+}
+
+// Drop the reference held by the thread in slot tslot.
+// When the last thread lets go, free the page table and
+// the physical memory it refers to.
 void
-proc_freepagetable(pagetable_t pagetable, uint64 sz)
+proc_freepagetable(pagetable_t pagetable, uint64 sz, int tslot)
 {
+  int i, ref;
+
+  acquire(&ptrefs.lock);
+  for(i = 0; i < NELEM(ptrefs.pt); i++)
+    if(ptrefs.pt[i].ref > 0 && ptrefs.pt[i].pagetable == pagetable)
+      break;
+  if(i == NELEM(ptrefs.pt))
+    panic("proc_freepagetable");
+  uvmunmap(pagetable, THREADFRAME(tslot), 1, 0);
+  ptrefs.pt[i].slots &= ~(1 << tslot);
+  ref = --ptrefs.pt[i].ref;
+  release(&ptrefs.lock);
+
+  if(ref > 0)
+    return;
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
-  uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, USYSCALL, 1, 1);
+  ringfree(pagetable);
   uvmfree(pagetable, sz);
 }
 
+// Find an unused fdtable, with no open files, for a new
+// process.
+static struct fdtable*
+fdtalloc(void)
+{
+  struct fdtable *t;
+
+  for(t = fdtables; t < &fdtables[NPROC]; t++){
+    acquire(&t->lock);
+    if(t->ref == 0){
+      t->ref = 1;
+      release(&t->lock);
+      return t;
+    }
+    release(&t->lock);
+  }
+  return 0;
+}
+
+// Drop a process's reference to t. The last one to let go
+// closes the open files and the current directory, holding
+// on to t until they are closed so nobody reuses it.
+static void
+fdtput(struct fdtable *t)
+{
+  acquire(&t->lock);
+  if(t->ref > 1){
+    t->ref--;
+    release(&t->lock);
+    return;
+  }
+  release(&t->lock);
+
+  for(int fd = 0; fd < NOFILE; fd++){
+    if(t->ofile[fd]){
+      fileclose(t->ofile[fd]);
+      t->ofile[fd] = 0;
+    }
+  }
+  if(t->cwd){
+    begin_op();
+    iput(t->cwd);
+    end_op();
+    t->cwd = 0;
+  }
+
+  acquire(&t->lock);
+  t->ref = 0;
+  release(&t->lock);
+}
+
 // a user program that calls exec("/init")
 // od -t xC initcode
 uchar initcode[] = {
@@ -213,7 +474,7 @@ userinit(void)
 {
   struct proc *p;
 
-  p = allocproc();
+  p = allocproc(0);
   initproc = p;
   
   // allocate one user page and copy init's instructions
@@ -226,13 +487,55 @@ userinit(void)
   p->trapframe->sp = PGSIZE;  // user stack pointer
 
   safestrcpy(p->name, "initcode", sizeof(p->name));
-  p->cwd = namei("/");
+  p->fdt->cwd = namei("/");
 
   p->state = RUNNABLE;
 
   release(&p->lock);
 }
 
+// A kernel thread's first scheduling swtch()es here.
+static void
+kthreadstart(void)
+{
+  struct proc *p = myproc();
+
+  // Still holding p->lock from scheduler.
+  release(&p->lock);
+  p->kfn();
+  panic("kthread returned");
+}
+
+// Start a kernel thread that runs fn and never returns to
+// user space, like the buffer cache's flusher, in one of the
+// slots past proc[NPROC-1].
+void
+kthread(void (*fn)(void), char *name)
+{
+  struct proc *p;
+
+  for(p = &proc[NPROC]; p < &proc[NPROC+NKPROC]; p++){
+    acquire(&p->lock);
+    if(p->state == UNUSED)
+      break;
+    release(&p->lock);
+  }
+  if(p == &proc[NPROC+NKPROC])
+    panic("kthread");
+  // a pid no process has, so that holdingsleep() can tell
+  // kernel threads apart.
+  p->pid = -1 - (p - &proc[NPROC]);
+  p->affinity = ~0L;
+  p->lastcpu = -1;
+  p->kfn = fn;
+  memset(&p->context, 0, sizeof(p->context));
+  p->context.ra = (uint64)kthreadstart;
+  p->context.sp = p->kstack + PGSIZE;
+  safestrcpy(p->name, name, sizeof(p->name));
+  p->state = RUNNABLE;
+  release(&p->lock);
+}
+
 // Grow or shrink user memory by n bytes.
 // Return 0 on success, -1 on failure.
 int
@@ -240,16 +543,31 @@ growproc(int n)
 {
   uint sz;
   struct proc *p = myproc();
+  struct proc *q;
 
+  // threads share the page table, so they must
+  // also share its size.
+  acquire(&ptrefs.lock);
   sz = p->sz;
   if(n > 0){
     if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
+      release(&ptrefs.lock);
       return -1;
     }
   } else if(n < 0){
+    // a thread running on another hart may have the pages in
+    // its TLB, and nothing can make it flush them, so memory
+    // only shrinks while it isn't shared.
+    if(ptrefcount(p->pagetable) > 1){
+      release(&ptrefs.lock);
+      return -1;
+    }
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
-  p->sz = sz;
+  for(q = proc; q < &proc[NPROC]; q++)
+    if(q->pagetable == p->pagetable)
+      q->sz = sz;
+  release(&ptrefs.lock);
   return 0;
 }
 
@@ -263,7 +581,7 @@ fork(void)
   struct proc *p = myproc();
 
   // Allocate process.
-  if((np = allocproc()) == 0){
+  if((np = allocproc(0)) == 0){
     return -1;
   }
 
@@ -275,6 +593,12 @@ fork(void)
   }
   np->sz = p->sz;
 
+  if(scstat_fork(np, p) < 0){
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+
   np->parent = p;
 
   // copy saved user registers.
@@ -283,14 +607,69 @@ fork(void)
   // Cause fork to return 0 in the child.
   np->trapframe->a0 = 0;
 
-  // copy the mask in the parent process
-  np->mask = p->mask;
+  // copy the mask in the parent process, if it asked.
+  tracefork(np, p);
+
+  // children inherit the parent's affinity.
+  np->affinity = p->affinity;
 
   // increment reference counts on open file descriptors.
+  acquire(&p->fdt->lock);
   for(i = 0; i < NOFILE; i++)
-    if(p->ofile[i])
-      np->ofile[i] = filedup(p->ofile[i]);
-  np->cwd = idup(p->cwd);
+    if(p->fdt->ofile[i])
+      np->fdt->ofile[i] = filedup(p->fdt->ofile[i]);
+  np->fdt->cwd = idup(p->fdt->cwd);
+  release(&p->fdt->lock);
+
+  safestrcpy(np->name, p->name, sizeof(p->name));
+
+  pid = np->pid;
+
+  np->state = RUNNABLE;
+
+  release(&np->lock);
+
+  return pid;
+}
+
+// Create a new thread that shares the caller's page table,
+// and starts executing fcn(arg) on the user stack whose lowest
+// address is stack, which must be PGSIZE bytes long.
+// Open files and the current directory are shared too, so
+// a file one thread opens or closes is open or closed in all.
+int
+clone(uint64 fcn, uint64 arg, uint64 stack)
+{
+  int pid;
+  struct proc *np;
+  struct proc *p = myproc();
+
+  if(stack + PGSIZE > p->sz || stack + PGSIZE < stack)
+    return -1;
+
+  if((np = allocproc(p)) == 0){
+    return -1;
+  }
+
+  if(scstat_fork(np, p) < 0){
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+
+  np->parent = p;
+  np->ustack = stack;
+
+  // start at fcn(arg), on the new stack. returning from
+  // fcn faults, so fcn must call exit().
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fcn;
+  np->trapframe->a0 = arg;
+  np->trapframe->ra = 0;
+  np->trapframe->sp = (stack + PGSIZE) & ~0xfL;
+
+  tracefork(np, p);
+  np->affinity = p->affinity;
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
@@ -340,19 +719,11 @@ exit(int status)
   if(p == initproc)
     panic("init exiting");
 
-  // Close all open files.
-  for(int fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd]){
-      struct file *f = p->ofile[fd];
-      fileclose(f);
-      p->ofile[fd] = 0;
-    }
-  }
+  // Close all open files, unless other threads still use them.
+  fdtput(p->fdt);
+  p->fdt = 0;
 
-  begin_op();
-  iput(p->cwd);
-  end_op();
-  p->cwd = 0;
+  tracedetach(p);
 
   // we might re-parent a child to init. we can't be precise about
   // waking up init, since we can't acquire its lock once we've
@@ -395,11 +766,33 @@ exit(int status)
   panic("zombie exit");
 }
 
+// Fill in *ru with p's own resource usage, plus that of its
+// reaped children if children is set.
+static void
+getru(struct proc *p, int children, struct rusage *ru)
+{
+  ru->utime = p->utime;
+  ru->stime = p->stime;
+  ru->nvcsw = p->nvcsw;
+  ru->nivcsw = p->nivcsw;
+  ru->nfault = p->nfault;
+  if(children){
+    ru->utime += p->cutime;
+    ru->stime += p->cstime;
+    ru->nvcsw += p->cnvcsw;
+    ru->nivcsw += p->cnivcsw;
+    ru->nfault += p->cnfault;
+  }
+}
+
 // Wait for a child process to exit and return its pid.
+// If ruaddr is non-zero, copy out the child's resource usage,
+// including that of the children it reaped.
 // Return -1 if this process has no children.
 int
-wait(uint64 addr)
+wait(uint64 addr, uint64 ruaddr)
 {
+  struct rusage ru;
   struct proc *np;
   int havekids, pid;
   struct proc *p = myproc();
@@ -419,16 +812,30 @@ wait(uint64 addr)
         // np->parent can't change between the check and the acquire()
         // because only the parent changes it, and we're the parent.
         acquire(&np->lock);
+        if(np->pagetable == p->pagetable){
+          // a thread of ours; join() reaps it.
+          release(&np->lock);
+          continue;
+        }
         havekids = 1;
         if(np->state == ZOMBIE){
           // Found one.
           pid = np->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                  sizeof(np->xstate)) < 0) {
+          getru(np, 1, &ru);
+          if((addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
+                                   sizeof(np->xstate)) < 0) ||
+             (ruaddr != 0 && copyout(p->pagetable, ruaddr, (char *)&ru,
+                                     sizeof(ru)) < 0)) {
             release(&np->lock);
             release(&p->lock);
             return -1;
           }
+          p->cutime += ru.utime;
+          p->cstime += ru.stime;
+          p->cnvcsw += ru.nvcsw;
+          p->cnivcsw += ru.nivcsw;
+          p->cnfault += ru.nfault;
+          scstat_reap(p, np);
           freeproc(np);
           release(&np->lock);
           release(&p->lock);
@@ -449,6 +856,138 @@ wait(uint64 addr)
   }
 }
 
+// Wait for a thread created by this thread's clone() to exit,
+// and return its pid. If tid is positive, wait for that thread
+// only. Copies the thread's user stack address to addr, so the
+// caller can free it.
+// Return -1 if there is no such thread.
+int
+join(int tid, uint64 addr)
+{
+  struct proc *np;
+  int havekids, pid;
+  struct proc *p = myproc();
+
+  acquire(&p->lock);
+
+  for(;;){
+    havekids = 0;
+    for(np = proc; np < &proc[NPROC]; np++){
+      if(np->parent == p && (tid <= 0 || np->pid == tid)){
+        acquire(&np->lock);
+        if(np->pagetable != p->pagetable){
+          release(&np->lock);
+          continue;
+        }
+        havekids = 1;
+        if(np->state == ZOMBIE){
+          pid = np->pid;
+          if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->ustack,
+                                  sizeof(np->ustack)) < 0) {
+            release(&np->lock);
+            release(&p->lock);
+            return -1;
+          }
+          scstat_reap(p, np);
+          freeproc(np);
+          release(&np->lock);
+          release(&p->lock);
+          return pid;
+        }
+        release(&np->lock);
+      }
+    }
+
+    if(!havekids || p->killed){
+      release(&p->lock);
+      return -1;
+    }
+    
+    sleep(p, &p->lock);
+  }
+}
+
+// Switch to chosen process p on this hart.  It is the
+// process's job to release its lock and then reacquire it
+// before jumping back to us.
+// Caller must hold p->lock.
+static void
+runproc(struct cpu *c, struct proc *p, int id)
+{
+  p->state = RUNNING;
+  p->nsched++;
+  if(p->lastcpu >= 0 && p->lastcpu != id)
+    p->nmigrate++;
+  p->lastcpu = id;
+  c->proc = p;
+  p->tstamp = r_time();
+  swtch(&c->context, &p->context);
+
+  // Process is done running for now.
+  // It should have changed its p->state before coming back.
+  // It was in the kernel since it last came from user space.
+  p->stime += r_time() - p->tstamp;
+  c->proc = 0;
+}
+
+// Start a new period for real-time process p if the current
+// one is over, and return the budget p has left in it.
+// Caller must hold p->lock.
+static int
+rtbudget(struct proc *p)
+{
+  uint elapsed = ticks - p->rt_start;
+
+  if(elapsed >= p->rt_period){
+    if(p->rt_budget > 0 && p->state == RUNNABLE)
+      p->rt_missed++;
+    p->rt_start += elapsed - elapsed % p->rt_period;
+    p->rt_budget = p->rt_runtime;
+  }
+  return p->rt_budget;
+}
+
+// Run the runnable real-time processes that have budget left,
+// earliest absolute deadline first, until there are none.
+// Returns 1 if any ran.
+static int
+edfrun(struct cpu *c, int id)
+{
+  struct proc *p, *best;
+  uint dl, bestdl = 0;
+  int ran = 0;
+
+  while(rt.nproc > 0){
+    // find the earliest deadline without holding two proc
+    // locks at once, then lock it and check it again.
+    best = 0;
+    for(p = proc; p < &proc[NPROC]; p++){
+      if(p->rt_period == 0)
+        continue;
+      acquire(&p->lock);
+      if(p->state == RUNNABLE && p->rt_period != 0 &&
+         (p->affinity & (1L << id)) && rtbudget(p) > 0){
+        dl = p->rt_start + p->rt_deadline;
+        if(best == 0 || (int)(dl - bestdl) < 0){
+          best = p;
+          bestdl = dl;
+        }
+      }
+      release(&p->lock);
+    }
+    if(best == 0)
+      break;
+    acquire(&best->lock);
+    if(best->state == RUNNABLE && best->rt_period != 0 &&
+       (best->affinity & (1L << id)) && rtbudget(best) > 0){
+      runproc(c, best, id);
+      ran = 1;
+    }
+    release(&best->lock);
+  }
+  return ran;
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
@@ -456,35 +995,39 @@ wait(uint64 addr)
 //  - swtch to start running that process.
 //  - eventually that process transfers control
 //    via swtch back to the scheduler.
+// Real-time processes with budget left always run first, in
+// deadline order. Then each pass runs the ordinary processes
+// that last ran on this hart, whose cache and TLB state may
+// still be warm here, followed by the rest. A process only runs
+// on the harts in its affinity mask.
 void
 scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int id = cpuid();
   
+  __sync_fetch_and_or(&cpus_online, 1L << id);
+
   c->proc = 0;
   for(;;){
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
     
-    int found = 0;
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-
-        found = 1;
+    int found = edfrun(c, id);
+    for(int local = 1; local >= 0; local--){
+      for(p = proc; p < &proc[NPROC+NKPROC]; p++) {
+        int ran = 0;
+        acquire(&p->lock);
+        if(p->state == RUNNABLE && p->rt_period == 0 &&
+           (p->affinity & (1L << id)) && (p->lastcpu == id) == local) {
+          runproc(c, p, id);
+          ran = found = 1;
+        }
+        release(&p->lock);
+        if(ran)
+          edfrun(c, id);
       }
-      release(&p->lock);
     }
     if(found == 0) {
       intr_on();
@@ -515,11 +1058,31 @@ sched(void)
   if(intr_get())
     panic("sched interruptible");
 
+  if(p->state == SLEEPING)
+    p->nvcsw++;
+  else if(p->state == RUNNABLE)
+    p->nivcsw++;
+
   intena = mycpu()->intena;
   swtch(&p->context, &mycpu()->context);
   mycpu()->intena = intena;
 }
 
+// Charge a timer tick to the current process; called
+// from the timer interrupt path before yield(). A
+// real-time process that has used up its budget won't
+// be scheduled again until its next period.
+void
+sched_tick(void)
+{
+  struct proc *p = myproc();
+
+  acquire(&p->lock);
+  if(p->rt_period && --p->rt_budget == 0)
+    p->rt_throttled++;
+  release(&p->lock);
+}
+
 // Give up the CPU for one scheduling round.
 void
 yield(void)
@@ -593,7 +1156,7 @@ wakeup(void *chan)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
+  for(p = proc; p < &proc[NPROC+NKPROC]; p++) {
     acquire(&p->lock);
     if(p->state == SLEEPING && p->chan == chan) {
       p->state = RUNNABLE;
@@ -602,6 +1165,26 @@ wakeup(void *chan)
   }
 }
 
+// Wake up at most n processes sleeping on chan, and
+// return how many were woken.
+// Must be called without any p->lock.
+int
+wakeupn(void *chan, int n)
+{
+  struct proc *p;
+  int woken = 0;
+
+  for(p = proc; p < &proc[NPROC+NKPROC] && woken < n; p++) {
+    acquire(&p->lock);
+    if(p->state == SLEEPING && p->chan == chan) {
+      p->state = RUNNABLE;
+      woken++;
+    }
+    release(&p->lock);
+  }
+  return woken;
+}
+
 // Wake up p if it is sleeping in wait(); used by exit().
 // Caller must hold p->lock.
 static void
@@ -638,6 +1221,173 @@ kill(int pid)
   return -1;
 }
 
+// Restrict the process with the given pid (0 for the
+// caller) to the harts in mask.
+// Returns -1 if there is no such process, or if mask
+// includes no hart that is running.
+int
+sched_setaffinity(int pid, uint64 mask)
+{
+  struct proc *p;
+  struct proc *me = myproc();
+
+  if((mask & cpus_online) == 0)
+    return -1;
+  if(pid == 0)
+    pid = me->pid;
+
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED){
+      p->affinity = mask;
+      release(&p->lock);
+      // move off this hart now if it is no longer allowed.
+      if(p == me){
+        push_off();
+        int id = cpuid();
+        pop_off();
+        if((mask & (1L << id)) == 0)
+          yield();
+      }
+      return 0;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
+// Return the affinity mask of the process with the given
+// pid (0 for the caller), or -1 if there is none.
+uint64
+sched_getaffinity(int pid)
+{
+  struct proc *p;
+  uint64 mask;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED){
+      mask = p->affinity & cpus_online;
+      release(&p->lock);
+      return mask;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
+// Put the process with the given pid (0 for the caller) in
+// the real-time class: runtime ticks of CPU in every period,
+// finished by deadline ticks after the period starts. A
+// runtime of 0 returns it to the ordinary class.
+// Returns -1 if the parameters are inconsistent, if there is
+// no such process, or if admitting it would reserve more than
+// RTUTIL percent of a hart.
+int
+sched_setrt(int pid, int runtime, int period, int deadline)
+{
+  struct proc *p;
+  int util = 0, old;
+
+  if(runtime < 0 || (runtime > 0 && (runtime > deadline || deadline > period)))
+    return -1;
+  if(runtime > 0)
+    util = rtutil(runtime, deadline);
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  acquire(&rt.lock);
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED && p->state != ZOMBIE){
+      old = p->rt_period ? rtutil(p->rt_runtime, p->rt_deadline) : 0;
+      if(rt.util - old + util > RTUTIL * 10){
+        release(&p->lock);
+        release(&rt.lock);
+        return -1;
+      }
+      __sync_fetch_and_add(&rt.util, util - old);
+      __sync_fetch_and_add(&rt.nproc, (runtime > 0) - (p->rt_period != 0));
+      if(runtime > 0){
+        p->rt_runtime = runtime;
+        p->rt_period = period;
+        p->rt_deadline = deadline;
+        p->rt_start = ticks;
+        p->rt_budget = runtime;
+      } else {
+        p->rt_period = 0;
+      }
+      release(&p->lock);
+      release(&rt.lock);
+      return 0;
+    }
+    release(&p->lock);
+  }
+  release(&rt.lock);
+  return -1;
+}
+
+// Copy the resource usage of the caller (RUSAGE_SELF) or
+// of its reaped children (RUSAGE_CHILDREN) to user address addr.
+int
+getrusage(int who, uint64 addr)
+{
+  struct proc *p = myproc();
+  struct rusage ru, self;
+
+  if(who != RUSAGE_SELF && who != RUSAGE_CHILDREN)
+    return -1;
+
+  acquire(&p->lock);
+  getru(p, 1, &ru);
+  getru(p, 0, &self);
+  release(&p->lock);
+  if(who == RUSAGE_SELF){
+    // include the time spent getting here.
+    self.stime += r_time() - p->tstamp;
+    ru = self;
+  } else {
+    ru.utime -= self.utime;
+    ru.stime -= self.stime;
+    ru.nvcsw -= self.nvcsw;
+    ru.nivcsw -= self.nivcsw;
+    ru.nfault -= self.nfault;
+  }
+  return copyout(p->pagetable, addr, (char *)&ru, sizeof(ru));
+}
+
+// Copy scheduling statistics for the process with the
+// given pid (0 for the caller) to user address addr.
+// Returns -1 if there is no such process.
+int
+schedstat(int pid, uint64 addr)
+{
+  struct proc *p;
+  struct schedstat st;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED){
+      st.affinity = p->affinity & cpus_online;
+      st.lastcpu = p->lastcpu;
+      st.nsched = p->nsched;
+      st.nmigrate = p->nmigrate;
+      st.rtthrottled = p->rt_throttled;
+      st.rtmissed = p->rt_missed;
+      release(&p->lock);
+      return copyout(myproc()->pagetable, addr, (char *)&st, sizeof(st));
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
 // Copy to either a user address, or kernel address,
 // depending on usr_dst.
 // Returns 0 on success, -1 on error.
@@ -705,4 +1455,85 @@ int nproc_num(){
       num++;
   }
   return num;
-}
\ No newline at end of file
+}
+// LOAD_SCALE * exp(-1/n) for windows of n = 10, 50 and
+// 150 ticks, which are 1, 5 and 15 seconds.
+static uint64 loadexp[3] = { 1853, 2007, 2034 };
+
+// Sample the number of runnable and running processes
+// into the load averages. Called by clockintr() every tick.
+// The states are read without locks; a sample that is off
+// by one now and then does not matter.
+void
+loadtick(void)
+{
+  struct proc *p;
+  uint64 nready = 0, nrun = 0, n;
+
+  for(p = proc; p < &proc[NPROC+NKPROC]; p++){
+    if(p->state == RUNNABLE)
+      nready++;
+    else if(p->state == RUNNING)
+      nrun++;
+  }
+  load.nrunnable = nready;
+  n = (nready + nrun) * LOAD_SCALE;
+  for(int i = 0; i < NELEM(load.avg); i++)
+    load.avg[i] = (load.avg[i] * loadexp[i] +
+                   n * (LOAD_SCALE - loadexp[i])) >> LOAD_SHIFT;
+}
+
+// Charge a timer interrupt to this hart as busy or idle.
+// Interrupts must be off.
+void
+cputick(void)
+{
+  struct cpu *c = mycpu();
+
+  if(c->proc)
+    c->busy++;
+  else
+    c->idle++;
+}
+
+// Count n events of kind which, one of the CS_ constants.
+void
+cpustat(int which, uint64 n)
+{
+  push_off();
+  cpustats[cpuid()][which] += n;
+  pop_off();
+}
+
+// Fill in the process, load and counter fields of *info.
+void
+procinfo(struct sysinfo *info)
+{
+  uint64 sum[NCPUSTAT];
+
+  info->nproc = nproc_num();
+  info->nrunnable = load.nrunnable;
+  for(int i = 0; i < NELEM(load.avg); i++)
+    info->loadavg[i] = load.avg[i];
+  info->ncpu = 0;
+  memset(sum, 0, sizeof(sum));
+  for(int i = 0; i < NCPU; i++){
+    if(cpus_online & (1L << i))
+      info->ncpu = i + 1;
+    info->cpu[i].busy = cpus[i].busy;
+    info->cpu[i].idle = cpus[i].idle;
+    for(int j = 0; j < NCPUSTAT; j++)
+      sum[j] += cpustats[i][j];
+  }
+  info->bhit = sum[CS_BHIT];
+  info->bmiss = sum[CS_BMISS];
+  info->diskread = sum[CS_DISKREAD];
+  info->diskwrite = sum[CS_DISKWRITE];
+  info->logcommit = sum[CS_LOGCOMMIT];
+  info->piperead = sum[CS_PIPEREAD];
+  info->pipewrite = sum[CS_PIPEWRITE];
+  info->readahead = sum[CS_READAHEAD];
+  info->diskreq = sum[CS_DISKREQ];
+  info->diskintr = sum[CS_DISKINTR];
+  info->disknotify = sum[CS_DISKNOTIFY];
+}
@@ -24,6 +24,12 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  struct mcsnode mcs[NMCS];   // Queue nodes for the spinlocks it holds
+  uint mcsused;               // Which of mcs[] are in use
+
+  // counters for sysinfo(). each hart updates only its own.
+  uint64 busy;                // Clock ticks spent running a process
+  uint64 idle;                // Clock ticks spent with nothing to run
 };
 
 extern struct cpu cpus[NCPU];
@@ -80,6 +86,15 @@ struct trapframe {
   /* 280 */ uint64 t6;
 };
 
+// Open files and current directory. fork() gives the child a
+// copy of its parent's; the threads clone() makes share one.
+struct fdtable {
+  struct spinlock lock;        // Protects these while shared
+  int ref;                     // Processes using it, or 0 if free
+  struct file *ofile[NOFILE];  // Open files
+  struct inode *cwd;           // Current directory
+};
+
 enum procstate { UNUSED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
@@ -93,15 +108,51 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
-  int mask;                    //the sys_call num for trace
+  uint64 mask;                 //the sys_call num for trace
+  int traceflags;              // TRACE_ flags from tracectl()
+  int tracearg;                // Argument TRACE_ARGEQ compares
+  uint64 traceval;             // Value it compares it with
+  struct file *tracefile;      // Where events go, or 0; see trace.c
+  uint64 affinity;             // Harts this process may run on
+  int lastcpu;                 // Hart it last ran on, or -1
+  uint64 nsched;               // Times scheduled
+  uint64 nmigrate;             // Times scheduled on a different hart
+
+  // earliest-deadline-first real-time class; rt_period is 0
+  // for ordinary round-robin processes. times are in ticks.
+  int rt_runtime;              // CPU budget per period
+  int rt_period;               // Length of a period
+  int rt_deadline;             // Deadline, relative to period start
+  uint rt_start;               // Start of the current period
+  int rt_budget;               // Budget left in the current period
+  uint64 rt_throttled;         // Times the budget ran out
+  uint64 rt_missed;            // Periods that ended with work left
+
+  // resource usage, for getrusage() and wait3(). times are in
+  // CLINT_FREQ cycles; the c* fields total reaped children.
+  uint64 tstamp;               // Start of the interval being timed
+  uint64 utime;                // Time in user space
+  uint64 stime;                // Time in the kernel
+  uint64 nvcsw;                // Voluntary context switches
+  uint64 nivcsw;               // Involuntary context switches
+  uint64 nfault;               // Page faults
+  uint64 cutime, cstime, cnvcsw, cnivcsw, cnfault;
+
+  // per-system-call profiles, or 0 unless scprofile(1) was called
+  // by this process or an ancestor. see scstat.c.
+  struct scstat *scstat;       // This process's calls
+  struct scstat *cscstat;      // Its reaped children's calls
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
-  pagetable_t pagetable;       // User page table
+  pagetable_t pagetable;       // User page table, shared by threads
+  struct usyscall *usyscall;   // Page mapped at USYSCALL, shared by threads
+  int tslot;                   // Thread slot; trapframe at THREADFRAME(tslot)
+  uint64 ustack;               // User stack given to clone(), for join()
   struct trapframe *trapframe; // data page for trampoline.S
   struct context context;      // swtch() here to run process
-  struct file *ofile[NOFILE];  // Open files
-  struct inode *cwd;           // Current directory
+  void (*kfn)(void);           // Body of a kernel thread, or 0
+  struct fdtable *fdt;         // Open files and cwd, maybe shared
   char name[16];               // Process name (debugging)
 };
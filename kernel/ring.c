@@ -0,0 +1,169 @@
+//
+// System call submission rings.
+//
+// ring_setup() maps a page holding a struct ring at RING.
+// The process queues many system calls in it and runs them
+// all with one ring_enter(), which saves a trap per call.
+// The ring belongs to the address space, so threads share it,
+// fork() does not copy it and exec() drops it.
+//
+// The kernel keeps its own copies of the indexes it owns,
+// sqhead and cqtail, and only ever reads the process's, so a
+// process that scribbles on its ring can only hurt itself.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "syscall.h"
+#include "ring.h"
+
+// system calls that may be queued. the rest change or
+// end the address space, or never return.
+static char ringable[] = {
+[SYS_read]    1,
+[SYS_write]   1,
+[SYS_open]    1,
+[SYS_close]   1,
+[SYS_fstat]   1,
+[SYS_dup]     1,
+[SYS_getpid]  1,
+[SYS_uptime]  1,
+[SYS_mknod]   1,
+[SYS_unlink]  1,
+[SYS_link]    1,
+[SYS_mkdir]   1,
+[SYS_chdir]   1,
+};
+
+struct {
+  struct spinlock lock;
+  struct {
+    pagetable_t pagetable;  // address space, or 0 if free
+    struct ring *ring;      // kernel address of the page
+    uint sqhead;
+    uint cqtail;
+    struct sleeplock lk;    // one ring_enter() at a time
+  } r[NPROC];
+} rings;
+
+void
+ringinit(void)
+{
+  initlock(&rings.lock, "rings");
+  for(int i = 0; i < NPROC; i++)
+    initsleeplock(&rings.r[i].lk, "ring");
+}
+
+// Map a ring into the caller's address space, if there
+// is not one already. Returns RING, or -1.
+uint64
+ring_setup(void)
+{
+  struct proc *p = myproc();
+  struct ring *ring;
+  int i, free = -1;
+
+  acquire(&rings.lock);
+  for(i = 0; i < NPROC; i++){
+    if(rings.r[i].pagetable == p->pagetable){
+      release(&rings.lock);
+      return RING;
+    }
+    if(rings.r[i].pagetable == 0 && free < 0)
+      free = i;
+  }
+  if(free < 0 || (ring = kalloc()) == 0){
+    release(&rings.lock);
+    return -1;
+  }
+  memset(ring, 0, PGSIZE);
+  if(mappages(p->pagetable, RING, PGSIZE, (uint64)ring, PTE_R | PTE_W | PTE_U) < 0){
+    kfree(ring);
+    release(&rings.lock);
+    return -1;
+  }
+  rings.r[free].pagetable = p->pagetable;
+  rings.r[free].ring = ring;
+  rings.r[free].sqhead = 0;
+  rings.r[free].cqtail = 0;
+  release(&rings.lock);
+  return RING;
+}
+
+// Run up to n queued system calls, stopping early if the
+// completion queue fills up. Returns the number run.
+int
+ring_enter(int n)
+{
+  struct proc *p = myproc();
+  struct ringsqe sqe;
+  struct ringcqe *cqe;
+  struct ring *ring;
+  int i, done, cancel;
+
+  acquire(&rings.lock);
+  for(i = 0; i < NPROC; i++)
+    if(rings.r[i].pagetable == p->pagetable)
+      break;
+  release(&rings.lock);
+  if(i == NPROC)
+    return -1;
+
+  // the slot can't be freed while p uses the page table.
+  acquiresleep(&rings.r[i].lk);
+  ring = rings.r[i].ring;
+  cancel = 0;
+  for(done = 0; done < n && !p->killed; done++){
+    __sync_synchronize();
+    if(ring->sqtail - rings.r[i].sqhead - 1 >= NRING)
+      break;  // empty, or a nonsense tail
+    if(rings.r[i].cqtail - ring->cqhead >= NRING)
+      break;  // no room for the completion
+    sqe = ring->sq[rings.r[i].sqhead % NRING];
+    ring->sqhead = ++rings.r[i].sqhead;
+
+    cqe = &ring->cq[rings.r[i].cqtail % NRING];
+    cqe->data = sqe.data;
+    cqe->flags = 0;
+    if(cancel){
+      cqe->res = -1;
+      cqe->flags = RING_CANCELED;
+    } else if(sqe.num > 0 && sqe.num < NELEM(ringable) && ringable[sqe.num]){
+      cqe->res = ringsyscall(sqe.num, sqe.arg);
+    } else {
+      cqe->res = -1;
+    }
+    if(sqe.flags & RING_LINK)
+      cancel = cancel || cqe->res < 0 ||
+        ((sqe.num == SYS_read || sqe.num == SYS_write) && cqe->res != (int)sqe.arg[2]);
+    else
+      cancel = 0;
+    __sync_synchronize();
+    ring->cqtail = ++rings.r[i].cqtail;
+  }
+  releasesleep(&rings.r[i].lk);
+  return done;
+}
+
+// Unmap and free pagetable's ring, if it has one. Called
+// when the last process using pagetable lets go of it.
+void
+ringfree(pagetable_t pagetable)
+{
+  acquire(&rings.lock);
+  for(int i = 0; i < NPROC; i++){
+    if(rings.r[i].pagetable == pagetable){
+      uvmunmap(pagetable, RING, 1, 1);
+      rings.r[i].pagetable = 0;
+      rings.r[i].ring = 0;
+      break;
+    }
+  }
+  release(&rings.lock);
+}
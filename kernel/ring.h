@@ -0,0 +1,39 @@
+// System call submission ring, shared between a process and
+// the kernel. ring_setup() maps one at RING; see ring.c.
+
+#define NRING  64  // entries in each queue; a power of two
+
+// ringsqe.flags
+#define RING_LINK      1  // run the next entry only if this one
+                          // succeeds; a short read or write fails
+
+// ringcqe.flags
+#define RING_CANCELED  1  // not run, since a linked entry failed
+
+// a system call to run.
+struct ringsqe {
+  int num;           // SYS_read, SYS_write, ...
+  int flags;
+  uint64 arg[3];
+  uint64 data;       // copied to the completion
+};
+
+// a system call that has run.
+struct ringcqe {
+  uint64 data;
+  int res;           // return value
+  int flags;
+};
+
+// the process writes submissions at sq[sqtail % NRING] and
+// advances sqtail; the kernel consumes them from sqhead.
+// the kernel writes completions at cq[cqtail % NRING] and
+// advances cqtail; the process consumes them from cqhead.
+struct ring {
+  uint sqhead;
+  uint sqtail;
+  uint cqhead;
+  uint cqtail;
+  struct ringsqe sq[NRING];
+  struct ringcqe cq[NRING];
+};
@@ -0,0 +1,10 @@
+#define RUSAGE_SELF      0  // the calling process
+#define RUSAGE_CHILDREN  1  // its children that have been waited for
+
+struct rusage {
+  uint64 utime;   // time in user space, in CLINT_FREQ cycles
+  uint64 stime;   // time in the kernel, in CLINT_FREQ cycles
+  uint64 nvcsw;   // voluntary context switches
+  uint64 nivcsw;  // involuntary context switches
+  uint64 nfault;  // page faults
+};
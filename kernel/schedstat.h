@@ -0,0 +1,8 @@
+struct schedstat {
+  uint64 affinity;    // harts the process may run on
+  int lastcpu;        // hart it last ran on, or -1
+  uint64 nsched;      // times it has been scheduled
+  uint64 nmigrate;    // times it was scheduled on a different hart
+  uint64 rtthrottled; // times a real-time process ran out of budget
+  uint64 rtmissed;    // real-time periods that ended with work left
+};
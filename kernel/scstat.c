@@ -0,0 +1,143 @@
+//
+// Per-system-call counters and latency histograms.
+//
+// syscall() times every call. System-wide profiles are kept
+// per hart, so recording needs no lock. A process also keeps
+// its own profile, and one for its reaped children, once it
+// calls scprofile(1); its children inherit that setting.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "syscall.h"
+#include "scstat.h"
+
+struct scstat cpuscstat[NCPU][NSCSTAT];
+
+// a process's profiles are a page each.
+_Static_assert(sizeof(struct scstat) * NSCSTAT <= PGSIZE, "scstat too big");
+
+static void
+record(struct scstat *st, uint64 ret, uint64 cycles)
+{
+  int b;
+
+  st->count++;
+  if((long)ret < 0)
+    st->errors++;
+  st->cycles += cycles;
+  for(b = 0; b < NLATBUCKET-1 && (cycles >> (b+1)) != 0; b++)
+    ;
+  st->hist[b]++;
+}
+
+static void
+add(struct scstat *to, struct scstat *from)
+{
+  for(int i = 0; i < NSCSTAT; i++){
+    to[i].count += from[i].count;
+    to[i].errors += from[i].errors;
+    to[i].cycles += from[i].cycles;
+    for(int b = 0; b < NLATBUCKET; b++)
+      to[i].hist[b] += from[i].hist[b];
+  }
+}
+
+// p's system call num returned ret after cycles.
+void
+scstat_record(struct proc *p, int num, uint64 ret, uint64 cycles)
+{
+  push_off();
+  record(&cpuscstat[cpuid()][num], ret, cycles);
+  pop_off();
+  if(p->scstat)
+    record(&p->scstat[num], ret, cycles);
+}
+
+// Start (on != 0) or stop keeping the caller's own profile.
+// Starting again clears it.
+int
+scprofile(int on)
+{
+  struct proc *p = myproc();
+
+  if(!on){
+    scstat_free(p);
+    return 0;
+  }
+  if(p->scstat == 0 && (p->scstat = kalloc()) == 0)
+    return -1;
+  if(p->cscstat == 0 && (p->cscstat = kalloc()) == 0){
+    scstat_free(p);
+    return -1;
+  }
+  memset(p->scstat, 0, PGSIZE);
+  memset(p->cscstat, 0, PGSIZE);
+  return 0;
+}
+
+// Give fork()'s child np an empty profile if its parent p
+// keeps one. Returns -1 if out of memory.
+int
+scstat_fork(struct proc *np, struct proc *p)
+{
+  if(p->scstat == 0)
+    return 0;
+  if((np->scstat = kalloc()) == 0 || (np->cscstat = kalloc()) == 0)
+    return -1;
+  memset(np->scstat, 0, PGSIZE);
+  memset(np->cscstat, 0, PGSIZE);
+  return 0;
+}
+
+// p is reaping child np; add np's profiles to p's.
+void
+scstat_reap(struct proc *p, struct proc *np)
+{
+  if(p->cscstat == 0 || np->scstat == 0)
+    return;
+  add(p->cscstat, np->scstat);
+  add(p->cscstat, np->cscstat);
+}
+
+void
+scstat_free(struct proc *p)
+{
+  if(p->scstat)
+    kfree(p->scstat);
+  if(p->cscstat)
+    kfree(p->cscstat);
+  p->scstat = 0;
+  p->cscstat = 0;
+}
+
+// Copy the NSCSTAT profiles chosen by who to user address addr.
+// Returns NSCSTAT, or -1 if the caller keeps no profile.
+int
+scstat_read(int who, uint64 addr)
+{
+  struct proc *p = myproc();
+  struct scstat *st;
+  int r;
+
+  if(who == SCSTAT_SELF || who == SCSTAT_CHILDREN){
+    st = who == SCSTAT_SELF ? p->scstat : p->cscstat;
+    if(st == 0)
+      return -1;
+    if(copyout(p->pagetable, addr, (char *)st, sizeof(struct scstat) * NSCSTAT) < 0)
+      return -1;
+    return NSCSTAT;
+  }
+  if(who != SCSTAT_SYSTEM || (st = kalloc()) == 0)
+    return -1;
+  memset(st, 0, PGSIZE);
+  for(int i = 0; i < NCPU; i++)
+    add(st, cpuscstat[i]);
+  r = copyout(p->pagetable, addr, (char *)st, sizeof(struct scstat) * NSCSTAT);
+  kfree(st);
+  return r < 0 ? -1 : NSCSTAT;
+}
@@ -0,0 +1,17 @@
+// needs syscall.h.
+#define NSCSTAT     SYS_MAX  // profiles, one per system call number
+#define NLATBUCKET  20  // log2 latency histogram buckets
+
+// Profile of one system call. Times are in CLINT_FREQ cycles.
+struct scstat {
+  uint count;             // calls
+  uint errors;            // calls that returned a negative value
+  uint64 cycles;          // total time spent in the call
+  uint hist[NLATBUCKET];  // calls taking [2^i, 2^(i+1)) cycles;
+                          // the last bucket also counts longer ones
+};
+
+// who argument of scstat()
+#define SCSTAT_SYSTEM    0  // every process since boot
+#define SCSTAT_SELF      1  // the caller, since it called scprofile(1)
+#define SCSTAT_CHILDREN  2  // the caller's reaped, profiled children
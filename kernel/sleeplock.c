@@ -9,24 +9,98 @@
 #include "proc.h"
 #include "sleeplock.h"
 
+// How long, in cycles of the time CSR, a waiter spins on
+// a running holder before going to sleep. Buffer and inode
+// locks are mostly held for less than this, and a sleep and
+// wakeup costs two context switches.
+#define SPINWAIT 500   // 50us
+
+
 void
 initsleeplock(struct sleeplock *lk, char *name)
 {
   initlock(&lk->lk, "sleep lock");
   lk->name = name;
   lk->locked = 0;
+  lk->readers = 0;
+  lk->wwait = 0;
   lk->pid = 0;
+  lk->owner = 0;
+  memset(&lk->prof, 0, sizeof(lk->prof));
+  sleeplocklink(lk);
+}
+
+// While lk's exclusive holder is running on another hart,
+// spin for up to SPINWAIT cycles waiting for it to let go,
+// rather than sleep. Returns at once if there is no such
+// holder. Called and returns with lk->lk held.
+static void
+spinwait(struct sleeplock *lk)
+{
+  struct proc *owner = lk->owner;
+  uint64 t0;
+
+  // owner->state is read without owner->lock; it is only
+  // a hint, and proc structs are never freed.
+  if (owner == 0 || owner == myproc() || owner->state != RUNNING)
+    return;
+  release(&lk->lk);
+  t0 = r_time();
+  while (*(volatile uint *)&lk->locked &&
+         *(struct proc * volatile *)&lk->owner == owner &&
+         *(volatile enum procstate *)&owner->state == RUNNING &&
+         r_time() - t0 < SPINWAIT)
+    ;
+  acquire(&lk->lk);
+}
+
+// Count how a contended acquire of lk ended.
+static void
+waited(struct sleeplock *lk, uint64 t0, int slept)
+{
+  lk->prof.ncontend++;
+  lk->prof.wait += r_time() - t0;
+  if (slept)
+    lk->prof.nsleep++;
+  else
+    lk->prof.nspin++;
+}
+
+// Take lk, which is about to be freed, off the lists
+// of locks.
+void
+freesleeplock(struct sleeplock *lk)
+{
+  freelock(&lk->lk);
+  sleeplockunlink(lk);
 }
 
 void
 acquiresleep(struct sleeplock *lk)
 {
+  int spun = 0, slept = 0;
+
   acquire(&lk->lk);
-  while (lk->locked) {
-    sleep(lk, &lk->lk);
+  if (lk->locked || lk->readers) {
+    uint64 t0 = r_time();
+    lk->wwait++;
+    while (lk->locked || lk->readers) {
+      if (!spun) {
+        spun = 1;
+        spinwait(lk);
+        continue;
+      }
+      slept = 1;
+      sleep(lk, &lk->lk);
+    }
+    lk->wwait--;
+    waited(lk, t0, slept);
   }
   lk->locked = 1;
+  lk->owner = myproc();
   lk->pid = myproc()->pid;
+  lk->prof.nacquire++;
+  lk->prof.start = r_time();
   release(&lk->lk);
 }
 
@@ -34,12 +108,61 @@ void
 releasesleep(struct sleeplock *lk)
 {
   acquire(&lk->lk);
+  uint64 hold = r_time() - lk->prof.start;
+  if (hold > lk->prof.maxhold)
+    lk->prof.maxhold = hold;
   lk->locked = 0;
+  lk->owner = 0;
   lk->pid = 0;
   wakeup(lk);
   release(&lk->lk);
 }
 
+// Acquire lk shared with other readers. Readers must not
+// nest: a writer queued between the two acquires would
+// deadlock them.
+void
+acquiresleepread(struct sleeplock *lk)
+{
+  int spun = 0, slept = 0;
+
+  acquire(&lk->lk);
+  if (lk->locked || lk->wwait) {
+    uint64 t0 = r_time();
+    while (lk->locked || lk->wwait) {
+      if (!spun) {
+        spun = 1;
+        spinwait(lk);
+        continue;
+      }
+      slept = 1;
+      sleep(lk, &lk->lk);
+    }
+    waited(lk, t0, slept);
+  }
+  // the hold time covers the whole span during
+  // which some reader had the lock.
+  if (lk->readers++ == 0)
+    lk->prof.start = r_time();
+  lk->prof.nacquire++;
+  release(&lk->lk);
+}
+
+void
+releasesleepread(struct sleeplock *lk)
+{
+  acquire(&lk->lk);
+  if (lk->readers < 1)
+    panic("releasesleepread");
+  if (--lk->readers == 0) {
+    uint64 hold = r_time() - lk->prof.start;
+    if (hold > lk->prof.maxhold)
+      lk->prof.maxhold = hold;
+    wakeup(lk);
+  }
+  release(&lk->lk);
+}
+
 int
 holdingsleep(struct sleeplock *lk)
 {
@@ -51,5 +174,15 @@ holdingsleep(struct sleeplock *lk)
   return r;
 }
 
+// Is lk held shared by somebody? Readers aren't tracked
+// individually, so this can't tell whether it is us.
+int
+holdingsleepread(struct sleeplock *lk)
+{
+  int r;
 
-
+  acquire(&lk->lk);
+  r = lk->readers > 0;
+  release(&lk->lk);
+  return r;
+}
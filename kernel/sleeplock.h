@@ -1,10 +1,19 @@
-// Long-term locks for processes
+// Long-term locks for processes. A sleep lock is taken either
+// exclusively (acquiresleep) or shared by readers
+// (acquiresleepread); a waiting writer holds off new readers.
 struct sleeplock {
-  uint locked;       // Is the lock held?
+  uint locked;       // Is the lock held exclusively?
+  int readers;       // Number of shared holders
+  int wwait;         // Writers waiting for it
   struct spinlock lk; // spinlock protecting this sleep lock
   
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+  struct proc *owner; // Process holding lock exclusively
+
+  struct lockprof prof;   // Protected by lk
+  struct sleeplock *next; // In the list of all sleep locks
+  struct sleeplock **pprev;
 };
 
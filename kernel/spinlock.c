@@ -1,4 +1,10 @@
 // Mutual exclusion spin locks.
+//
+// These are MCS queue locks. A hart that wants the lock swaps
+// its own node into lk->tail, links itself behind the previous
+// tail, and spins on its own node's wait flag, which only its
+// predecessor writes. So waiters don't all hammer the lock's
+// cache line, and the lock goes to them in arrival order.
 
 #include "types.h"
 #include "param.h"
@@ -6,14 +12,71 @@
 #include "spinlock.h"
 #include "riscv.h"
 #include "proc.h"
+#include "sleeplock.h"
+#include "lockstat.h"
 #include "defs.h"
 
+// every initialized lock, for lockstat(). a zeroed spinlock
+// is a free one, so locks.lock works without initlock(),
+// which keeps it off its own list.
+struct {
+  struct spinlock lock;
+  struct spinlock *spin;
+  struct sleeplock *sleep;
+  struct rwspinlock *rw;
+} locks;
+
 void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
-  lk->locked = 0;
+  lk->tail = 0;
+  lk->owner = 0;
   lk->cpu = 0;
+  memset(&lk->prof, 0, sizeof(lk->prof));
+
+  acquire(&locks.lock);
+  lk->next = locks.spin;
+  lk->pprev = &locks.spin;
+  if(lk->next)
+    lk->next->pprev = &lk->next;
+  locks.spin = lk;
+  release(&locks.lock);
+}
+
+// Take lk, which is about to be freed, off the list of locks.
+void
+freelock(struct spinlock *lk)
+{
+  acquire(&locks.lock);
+  *lk->pprev = lk->next;
+  if(lk->next)
+    lk->next->pprev = lk->pprev;
+  release(&locks.lock);
+}
+
+// Add a sleep lock to the list of locks.
+void
+sleeplocklink(struct sleeplock *lk)
+{
+  acquire(&locks.lock);
+  lk->next = locks.sleep;
+  lk->pprev = &locks.sleep;
+  if(lk->next)
+    lk->next->pprev = &lk->next;
+  locks.sleep = lk;
+  release(&locks.lock);
+}
+
+// Take a sleep lock off the list of locks.
+void
+sleeplockunlink(struct sleeplock *lk)
+{
+  acquire(&locks.lock);
+  *lk->pprev = lk->next;
+  if(lk->next)
+    lk->next->pprev = lk->pprev;
+  release(&locks.lock);
 }
 
 // Acquire the lock.
@@ -21,16 +84,41 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  struct cpu *c;
+  struct mcsnode *n, *prev;
+  int i;
+
   push_off(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
-  // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
-  //   a5 = 1
-  //   s1 = &lk->locked
-  //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+  // take a free node.
+  c = mycpu();
+  for(i = 0; i < NMCS; i++)
+    if((c->mcsused & (1 << i)) == 0)
+      break;
+  if(i == NMCS)
+    panic("acquire: too many locks");
+  c->mcsused |= 1 << i;
+  n = &c->mcs[i];
+  n->next = 0;
+  n->wait = 1;
+
+  // make the node's contents visible before it is queued,
+  // then join the queue. on RISC-V, sync_lock_test_and_set
+  // turns into an atomic swap:
+  //   amoswap.d.aq a5, a5, (s1)
+  __sync_synchronize();
+  prev = __sync_lock_test_and_set(&lk->tail, n);
+  if(prev){
+    // wait for prev's holder to hand the lock over.
+    uint64 t0 = r_time();
+    *(struct mcsnode * volatile *)&prev->next = n;
+    while(*(volatile uint *)&n->wait)
+      ;
+    lk->prof.ncontend++;
+    lk->prof.wait += r_time() - t0;
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -39,16 +127,28 @@ acquire(struct spinlock *lk)
   __sync_synchronize();
 
   // Record info about lock acquisition for holding() and debugging.
-  lk->cpu = mycpu();
+  lk->owner = n;
+  lk->cpu = c;
+  lk->prof.nacquire++;
+  lk->prof.start = r_time();
 }
 
 // Release the lock.
 void
 release(struct spinlock *lk)
 {
+  struct cpu *c = mycpu();
+  struct mcsnode *n, *next;
+
   if(!holding(lk))
     panic("release");
 
+  uint64 hold = r_time() - lk->prof.start;
+  if(hold > lk->prof.maxhold)
+    lk->prof.maxhold = hold;
+
+  n = lk->owner;
+  lk->owner = 0;
   lk->cpu = 0;
 
   // Tell the C compiler and the CPU to not move loads or stores
@@ -59,15 +159,25 @@ release(struct spinlock *lk)
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code doesn't use a C assignment, since the C standard
-  // implies that an assignment might be implemented with
-  // multiple store instructions.
-  // On RISC-V, sync_lock_release turns into an atomic swap:
-  //   s1 = &lk->locked
-  //   amoswap.w zero, zero, (s1)
-  __sync_lock_release(&lk->locked);
+  // With nobody queued behind us, the lock becomes free
+  // by swinging tail back to 0. If that fails, a hart has
+  // swapped itself in and is about to link itself to n.
+  next = *(struct mcsnode * volatile *)&n->next;
+  if(next == 0){
+    if(__sync_bool_compare_and_swap(&lk->tail, n, 0))
+      goto out;
+    while((next = *(struct mcsnode * volatile *)&n->next) == 0)
+      ;
+  }
 
+  // hand the lock to the next hart. This code doesn't use
+  // a plain C assignment, since the C standard implies that
+  // an assignment might be implemented with multiple store
+  // instructions.
+  *(volatile uint *)&next->wait = 0;
+
+out:
+  c->mcsused &= ~(1 << (n - c->mcs));
   pop_off();
 }
 
@@ -77,10 +187,108 @@ int
 holding(struct spinlock *lk)
 {
   int r;
-  r = (lk->locked && lk->cpu == mycpu());
+  r = (lk->tail != 0 && lk->cpu == mycpu());
   return r;
 }
 
+void
+initrwlock(struct rwspinlock *lk, char *name)
+{
+  lk->name = name;
+  lk->cnt = 0;
+  lk->wwait = 0;
+  lk->cpu = 0;
+  memset(&lk->prof, 0, sizeof(lk->prof));
+
+  acquire(&locks.lock);
+  lk->next = locks.rw;
+  locks.rw = lk;
+  release(&locks.lock);
+}
+
+// Acquire lk shared with other readers. Readers only touch
+// lk->cnt, with one atomic add each way, so they don't
+// serialize behind each other the way acquire() does.
+// Readers must not nest: a writer arriving between the two
+// acquires would deadlock them.
+void
+acquireread(struct rwspinlock *lk)
+{
+  int n, spun = 0;
+  uint64 t0 = 0;
+
+  push_off();
+  for(;;){
+    n = *(volatile int *)&lk->cnt;
+    if(n >= 0 && *(volatile int *)&lk->wwait == 0 &&
+       __sync_bool_compare_and_swap(&lk->cnt, n, n + 1))
+      break;
+    if(!spun){
+      spun = 1;
+      t0 = r_time();
+    }
+  }
+  __sync_synchronize();
+
+  __sync_fetch_and_add(&lk->prof.nacquire, 1);
+  if(spun){
+    __sync_fetch_and_add(&lk->prof.ncontend, 1);
+    __sync_fetch_and_add(&lk->prof.wait, r_time() - t0);
+  }
+}
+
+void
+releaseread(struct rwspinlock *lk)
+{
+  if(*(volatile int *)&lk->cnt <= 0)
+    panic("releaseread");
+  __sync_synchronize();
+  __sync_fetch_and_sub(&lk->cnt, 1);
+  pop_off();
+}
+
+// Acquire lk exclusively. Spins until the readers drain.
+void
+acquirewrite(struct rwspinlock *lk)
+{
+  uint64 t0;
+
+  push_off();
+  if(lk->cpu == mycpu())
+    panic("acquirewrite");
+
+  if(!__sync_bool_compare_and_swap(&lk->cnt, 0, -1)){
+    t0 = r_time();
+    __sync_fetch_and_add(&lk->wwait, 1);
+    while(!__sync_bool_compare_and_swap(&lk->cnt, 0, -1))
+      ;
+    __sync_fetch_and_sub(&lk->wwait, 1);
+    lk->prof.ncontend++;
+    lk->prof.wait += r_time() - t0;
+  }
+  __sync_synchronize();
+
+  lk->cpu = mycpu();
+  lk->prof.nacquire++;
+  lk->prof.start = r_time();
+}
+
+void
+releasewrite(struct rwspinlock *lk)
+{
+  if(lk->cnt != -1 || lk->cpu != mycpu())
+    panic("releasewrite");
+
+  uint64 hold = r_time() - lk->prof.start;
+  if(hold > lk->prof.maxhold)
+    lk->prof.maxhold = hold;
+  lk->cpu = 0;
+
+  __sync_synchronize();
+  *(volatile int *)&lk->cnt = 0;
+  pop_off();
+}
+
 // push_off/pop_off are like intr_off()/intr_on() except that they are matched:
 // it takes two pop_off()s to undo two push_off()s.  Also, if interrupts
 // are initially off, then push_off, pop_off leaves them off.
@@ -108,3 +316,71 @@ pop_off(void)
   if(c->noff == 0 && c->intena)
     intr_on();
 }
+
+static void
+lockcopy(struct lockstat *st, char *name, void *id, int kind, struct lockprof *prof)
+{
+  safestrcpy(st->name, name ? name : "?", sizeof(st->name));
+  st->id = (uint64)id;
+  st->kind = kind;
+  st->nacquire = prof->nacquire;
+  st->ncontend = prof->ncontend;
+  st->wait = prof->wait;
+  st->maxhold = prof->maxhold;
+  st->nspin = prof->nspin;
+  st->nsleep = prof->nsleep;
+}
+
+// Copy the statistics of up to n locks to user address
+// addr, and return how many were copied. If addr is 0,
+// reset every lock's statistics instead.
+int
+lockstat(uint64 addr, int n)
+{
+  struct proc *p = myproc();
+  struct spinlock *sp;
+  struct sleeplock *sl;
+  struct rwspinlock *rw;
+  struct lockstat st;
+  int i = 0;
+
+  acquire(&locks.lock);
+  if(addr == 0){
+    for(sp = locks.spin; sp; sp = sp->next){
+      sp->prof.nacquire = sp->prof.ncontend = 0;
+      sp->prof.wait = sp->prof.maxhold = 0;
+    }
+    for(sl = locks.sleep; sl; sl = sl->next){
+      sl->prof.nacquire = sl->prof.ncontend = 0;
+      sl->prof.wait = sl->prof.maxhold = 0;
+      sl->prof.nspin = sl->prof.nsleep = 0;
+    }
+    for(rw = locks.rw; rw; rw = rw->next){
+      rw->prof.nacquire = rw->prof.ncontend = 0;
+      rw->prof.wait = rw->prof.maxhold = 0;
+    }
+    release(&locks.lock);
+    return 0;
+  }
+  for(sp = locks.spin; sp && i < n; sp = sp->next, i++){
+    lockcopy(&st, sp->name, sp, LOCK_SPIN, &sp->prof);
+    if(copyout(p->pagetable, addr + i*sizeof(st), (char *)&st, sizeof(st)) < 0)
+      goto bad;
+  }
+  for(sl = locks.sleep; sl && i < n; sl = sl->next, i++){
+    lockcopy(&st, sl->name, sl, LOCK_SLEEP, &sl->prof);
+    if(copyout(p->pagetable, addr + i*sizeof(st), (char *)&st, sizeof(st)) < 0)
+      goto bad;
+  }
+  for(rw = locks.rw; rw && i < n; rw = rw->next, i++){
+    lockcopy(&st, rw->name, rw, LOCK_RW, &rw->prof);
+    if(copyout(p->pagetable, addr + i*sizeof(st), (char *)&st, sizeof(st)) < 0)
+      goto bad;
+  }
+  release(&locks.lock);
+  return i;
+
+ bad:
+  release(&locks.lock);
+  return -1;
+}
@@ -1,9 +1,59 @@
+// A hart's place in the queue of a spinlock. Each hart has
+// NMCS of them in its struct cpu, one for each lock it is
+// holding or waiting for.
+struct mcsnode {
+  struct mcsnode *next;  // Next hart in the queue
+  uint wait;             // Non-zero until the lock is handed over
+};
+
+// Locks nest about four deep at most, as when clone() holds
+// np->lock and ptrefs.lock and its kalloc() calls breclaim(),
+// which takes bcache.lock and one bucket lock. Interrupts are
+// off while a spinlock is held, so handlers never add to that.
+// Code that nests deeper, or takes a variable number of locks,
+// must be checked against NMCS.
+#define NMCS 8           // locks a hart can hold at once
+
+// Contention statistics for lockstat(), kept in each lock and
+// only updated by the lock's holder. Times are in cycles of
+// the time CSR.
+struct lockprof {
+  uint64 nacquire;       // Times acquired
+  uint64 ncontend;       // Times the acquirer had to wait
+  uint64 wait;           // Total time spent waiting
+  uint64 maxhold;        // Longest time held
+  uint64 start;          // When the holder got it
+  uint64 nspin;          // Sleep locks: waits that only spun
+  uint64 nsleep;         // Sleep locks: waits that slept
+};
+
 // Mutual exclusion lock.
 struct spinlock {
-  uint locked;       // Is the lock held?
+  struct mcsnode *tail;  // Last hart in the queue, or 0 if free
+  struct mcsnode *owner; // Holder's node, for release()
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+
+  struct lockprof prof;
+  struct spinlock *next;  // In the list of all spinlocks
+  struct spinlock **pprev;
 };
 
+
+// Reader-writer spin lock, for read-mostly data. Any number
+// of readers can hold it at once, or one writer alone. A
+// waiting writer keeps new readers out, so a steady stream
+// of readers can't starve it.
+struct rwspinlock {
+  int cnt;           // Readers holding it, or -1 if a writer does
+  int wwait;         // Writers waiting for it
+
+  // For debugging:
+  char *name;        // Name of lock.
+  struct cpu *cpu;   // The cpu of the writer holding it.
+
+  struct lockprof prof;     // nacquire, ncontend and wait are atomic
+  struct rwspinlock *next;  // In the list of all rw spinlocks
+};
@@ -107,6 +107,24 @@ extern uint64 sys_write(void);
 extern uint64 sys_uptime(void);
 extern uint64 sys_trace(void);
 extern uint64 sys_sysinfo(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_join(void);
+extern uint64 sys_futex_wait(void);
+extern uint64 sys_futex_wake(void);
+extern uint64 sys_sched_setaffinity(void);
+extern uint64 sys_sched_getaffinity(void);
+extern uint64 sys_schedstat(void);
+extern uint64 sys_sched_setrt(void);
+extern uint64 sys_wait3(void);
+extern uint64 sys_getrusage(void);
+extern uint64 sys_traceread(void);
+extern uint64 sys_scstat(void);
+extern uint64 sys_scprofile(void);
+extern uint64 sys_ring_setup(void);
+extern uint64 sys_ring_enter(void);
+extern uint64 sys_tracectl(void);
+extern uint64 sys_lockstat(void);
+extern uint64 sys_diskctl(void);
 
 static uint64 (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -132,24 +150,88 @@ static uint64 (*syscalls[])(void) = {
 [SYS_close]   sys_close,
 [SYS_trace]   sys_trace,
 [SYS_sysinfo] sys_sysinfo,
+[SYS_clone]   sys_clone,
+[SYS_join]    sys_join,
+[SYS_futex_wait] sys_futex_wait,
+[SYS_futex_wake] sys_futex_wake,
+[SYS_sched_setaffinity] sys_sched_setaffinity,
+[SYS_sched_getaffinity] sys_sched_getaffinity,
+[SYS_schedstat] sys_schedstat,
+[SYS_sched_setrt] sys_sched_setrt,
+[SYS_wait3]   sys_wait3,
+[SYS_getrusage] sys_getrusage,
+[SYS_traceread] sys_traceread,
+[SYS_scstat]  sys_scstat,
+[SYS_scprofile] sys_scprofile,
+[SYS_ring_setup] sys_ring_setup,
+[SYS_ring_enter] sys_ring_enter,
+[SYS_tracectl] sys_tracectl,
+[SYS_lockstat] sys_lockstat,
+[SYS_diskctl] sys_diskctl,
 };
 
+// scstat.c keeps a profile for each entry.
+_Static_assert(NELEM(syscalls) == SYS_MAX, "SYS_MAX is wrong");
+
+// Report p's system call num, made with arguments arg[0..5],
+// to the tracer if p's mask selects it.
+static void
+traced(struct proc *p, int num, uint64 *arg, uint64 ret)
+{
+  if(p->mask && num < 64 && ((p->mask >> num) & 1))
+    tracesyscall(p, num, arg, ret);
+}
+
 void
 syscall(void)
 {
   int num;
   struct proc *p = myproc();
-  char* name[23]={"fork","exit","wait","pipe","read","kill","exec","fstat","chdir","dup","getpid",
-  "sbrk","sleep","uptime","open","write","mknod","inlink","link","mkdir","close","trace","sysinfo"};
+  uint64 arg[6];
+  uint64 start;
+
   num = p->trapframe->a7;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
+    // handlers may change the argument registers (a0 takes
+    // the return value, exec() sets a1), so save them first.
+    // the mask is checked afterwards, so that trace() itself,
+    // which sets it, shows up.
+    for(int i = 0; i < NELEM(arg); i++)
+      arg[i] = argraw(i);
+    start = r_time();
     p->trapframe->a0 = syscalls[num]();
-    if(1&((p->mask)>>num)){
-      printf("%d: syscall %s -> %d\n",p->pid,name[num-1],p->trapframe->a0);
-    }
+    scstat_record(p, num, p->trapframe->a0, r_time() - start);
+    traced(p, num, arg, p->trapframe->a0);
   } else {
     printf("%d %s: unknown sys call %d\n",
             p->pid, p->name, num);
     p->trapframe->a0 = -1;
   }
 }
+
+// Run system call num with arguments arg, for ring_enter().
+// The arguments are passed in the trapframe, as for a trap,
+// and the caller's own are put back afterwards. The call is
+// profiled and traced like one made by a trap.
+uint64
+ringsyscall(int num, uint64 *arg)
+{
+  struct proc *p = myproc();
+  uint64 targ[6] = { arg[0], arg[1], arg[2] };
+  uint64 a0 = p->trapframe->a0;
+  uint64 a1 = p->trapframe->a1;
+  uint64 a2 = p->trapframe->a2;
+  uint64 start, ret;
+
+  p->trapframe->a0 = arg[0];
+  p->trapframe->a1 = arg[1];
+  p->trapframe->a2 = arg[2];
+  start = r_time();
+  ret = syscalls[num]();
+  scstat_record(p, num, ret, r_time() - start);
+  traced(p, num, targ, ret);
+  p->trapframe->a0 = a0;
+  p->trapframe->a1 = a1;
+  p->trapframe->a2 = a2;
+  return ret;
+}
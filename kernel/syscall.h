@@ -22,3 +22,24 @@
 #define SYS_close  21
 #define SYS_trace  22
 #define SYS_sysinfo 23
+#define SYS_clone  24
+#define SYS_join   25
+#define SYS_futex_wait 26
+#define SYS_futex_wake 27
+#define SYS_sched_setaffinity 28
+#define SYS_sched_getaffinity 29
+#define SYS_schedstat 30
+#define SYS_sched_setrt 31
+#define SYS_wait3  32
+#define SYS_getrusage 33
+#define SYS_traceread 34
+#define SYS_scstat 35
+#define SYS_scprofile 36
+#define SYS_ring_setup 37
+#define SYS_ring_enter 38
+#define SYS_tracectl 39
+#define SYS_lockstat 40
+#define SYS_diskctl 41
+
+// one past the highest number above; keep it last.
+#define SYS_MAX 42
@@ -0,0 +1,45 @@
+// System call names, indexed by number.
+// Include after syscall.h.
+static char *syscallnames[] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_trace]   "trace",
+[SYS_sysinfo] "sysinfo",
+[SYS_clone]   "clone",
+[SYS_join]    "join",
+[SYS_futex_wait] "futex_wait",
+[SYS_futex_wake] "futex_wake",
+[SYS_sched_setaffinity] "sched_setaffinity",
+[SYS_sched_getaffinity] "sched_getaffinity",
+[SYS_schedstat] "schedstat",
+[SYS_sched_setrt] "sched_setrt",
+[SYS_wait3]   "wait3",
+[SYS_getrusage] "getrusage",
+[SYS_traceread] "traceread",
+[SYS_scstat]  "scstat",
+[SYS_scprofile] "scprofile",
+[SYS_ring_setup] "ring_setup",
+[SYS_ring_enter] "ring_enter",
+[SYS_tracectl] "tracectl",
+[SYS_lockstat] "lockstat",
+[SYS_diskctl] "diskctl",
+};
@@ -18,21 +18,47 @@
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
+// If other threads share the descriptor table, one of them could
+// close fd while the caller uses f, so f then comes with a
+// reference of its own and argfd() returns 1 rather than 0; the
+// caller gives it back with fdput().
 static int
 argfd(int n, int *pfd, struct file **pf)
 {
-  int fd;
+  int fd, held = 0;
   struct file *f;
+  struct fdtable *t = myproc()->fdt;
 
   if(argint(n, &fd) < 0)
     return -1;
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if(fd < 0 || fd >= NOFILE)
+    return -1;
+  // only this thread could make the table shared.
+  if(t->ref == 1){
+    f = t->ofile[fd];
+  } else {
+    acquire(&t->lock);
+    if((f = t->ofile[fd]) != 0){
+      filedup(f);
+      held = 1;
+    }
+    release(&t->lock);
+  }
+  if(f == 0)
     return -1;
   if(pfd)
     *pfd = fd;
   if(pf)
     *pf = f;
-  return 0;
+  return held;
+}
+
+// Drop the reference argfd() took, if it took one.
+static void
+fdput(struct file *f, int held)
+{
+  if(held)
+    fileclose(f);
 }
 
 // Allocate a file descriptor for the given file.
@@ -41,28 +67,53 @@ static int
 fdalloc(struct file *f)
 {
   int fd;
-  struct proc *p = myproc();
+  struct fdtable *t = myproc()->fdt;
 
+  acquire(&t->lock);
   for(fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd] == 0){
-      p->ofile[fd] = f;
+    if(t->ofile[fd] == 0){
+      t->ofile[fd] = f;
+      release(&t->lock);
       return fd;
     }
   }
+  release(&t->lock);
   return -1;
 }
 
+// Take f out of descriptor fd, unless another thread has
+// closed fd meanwhile. Returns 1 if it did, and the reference
+// fd held passes to the caller.
+static int
+fdremove(int fd, struct file *f)
+{
+  struct fdtable *t = myproc()->fdt;
+  int r = 0;
+
+  acquire(&t->lock);
+  if(t->ofile[fd] == f){
+    t->ofile[fd] = 0;
+    r = 1;
+  }
+  release(&t->lock);
+  return r;
+}
+
 uint64
 sys_dup(void)
 {
   struct file *f;
-  int fd;
+  int fd, held;
 
-  if(argfd(0, 0, &f) < 0)
+  if((held = argfd(0, 0, &f)) < 0)
     return -1;
-  if((fd=fdalloc(f)) < 0)
+  // the new descriptor's reference.
+  if(!held)
+    filedup(f);
+  if((fd=fdalloc(f)) < 0){
+    fileclose(f);
     return -1;
-  filedup(f);
+  }
   return fd;
 }
 
@@ -70,37 +121,42 @@ uint64
 sys_read(void)
 {
   struct file *f;
-  int n;
+  int n, held, r;
   uint64 p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || (held = argfd(0, 0, &f)) < 0)
     return -1;
-  return fileread(f, p, n);
+  r = fileread(f, p, n);
+  fdput(f, held);
+  return r;
 }
 
 uint64
 sys_write(void)
 {
   struct file *f;
-  int n;
+  int n, held, r;
   uint64 p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || (held = argfd(0, 0, &f)) < 0)
     return -1;
 
-  return filewrite(f, p, n);
+  r = filewrite(f, p, n);
+  fdput(f, held);
+  return r;
 }
 
 uint64
 sys_close(void)
 {
-  int fd;
+  int fd, held;
   struct file *f;
 
-  if(argfd(0, &fd, &f) < 0)
+  if((held = argfd(0, &fd, &f)) < 0)
     return -1;
-  myproc()->ofile[fd] = 0;
-  fileclose(f);
+  if(fdremove(fd, f))
+    fileclose(f);
+  fdput(f, held);
   return 0;
 }
 
@@ -109,10 +165,13 @@ sys_fstat(void)
 {
   struct file *f;
   uint64 st; // user pointer to struct stat
+  int held, r;
 
-  if(argfd(0, 0, &f) < 0 || argaddr(1, &st) < 0)
+  if(argaddr(1, &st) < 0 || (held = argfd(0, 0, &f)) < 0)
     return -1;
-  return filestat(f, st);
+  r = filestat(f, st);
+  fdput(f, held);
+  return r;
 }
 
 // Create the path new as a link to the same inode as old.
@@ -322,9 +381,7 @@ sys_open(void)
     return -1;
   }
 
-  if((f = filealloc()) == 0 || (fd = fdalloc(f)) < 0){
-    if(f)
-      fileclose(f);
+  if((f = filealloc()) == 0){
     iunlockput(ip);
     end_op();
     return -1;
@@ -336,6 +393,9 @@ sys_open(void)
   } else {
     f->type = FD_INODE;
     f->off = 0;
+    f->ranext = 0;
+    f->raend = 0;
+    f->rawin = (omode & O_RANDOM) ? -1 : 0;
   }
   f->ip = ip;
   f->readable = !(omode & O_WRONLY);
@@ -348,6 +408,12 @@ sys_open(void)
   iunlock(ip);
   end_op();
 
+  // only now that f is ready, since other threads sharing
+  // the descriptor table can use fd as soon as it's there.
+  if((fd = fdalloc(f)) < 0){
+    fileclose(f);
+    return -1;
+  }
   return fd;
 }
 
@@ -391,8 +457,8 @@ uint64
 sys_chdir(void)
 {
   char path[MAXPATH];
-  struct inode *ip;
-  struct proc *p = myproc();
+  struct inode *ip, *old;
+  struct fdtable *t = myproc()->fdt;
   
   begin_op();
   if(argstr(0, path, MAXPATH) < 0 || (ip = namei(path)) == 0){
@@ -406,9 +472,12 @@ sys_chdir(void)
     return -1;
   }
   iunlock(ip);
-  iput(p->cwd);
+  acquire(&t->lock);
+  old = t->cwd;
+  t->cwd = ip;
+  release(&t->lock);
+  iput(old);
   end_op();
-  p->cwd = ip;
   return 0;
 }
 
@@ -468,18 +537,17 @@ sys_pipe(void)
     return -1;
   fd0 = -1;
   if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
-    if(fd0 >= 0)
-      p->ofile[fd0] = 0;
-    fileclose(rf);
+    if(fd0 < 0 || fdremove(fd0, rf))
+      fileclose(rf);
     fileclose(wf);
     return -1;
   }
   if(copyout(p->pagetable, fdarray, (char*)&fd0, sizeof(fd0)) < 0 ||
      copyout(p->pagetable, fdarray+sizeof(fd0), (char *)&fd1, sizeof(fd1)) < 0){
-    p->ofile[fd0] = 0;
-    p->ofile[fd1] = 0;
-    fileclose(rf);
-    fileclose(wf);
+    if(fdremove(fd0, rf))
+      fileclose(rf);
+    if(fdremove(fd1, wf))
+      fileclose(wf);
     return -1;
   }
   return 0;
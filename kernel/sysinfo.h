@@ -1,4 +1,51 @@
+// sysinfo(info, size) fills in the first size bytes of *info.
+// Fields are only ever added at the end, so a program built
+// against an older struct sysinfo still works, and version
+// tells a newer program how much an older kernel filled in.
+// cpu[] has NCPU entries; include param.h first.
+
+#define SYSINFO_VERSION 5
+
+// load averages are fixed point, with LOAD_SCALE as 1.0.
+#define LOAD_SHIFT 11
+#define LOAD_SCALE (1 << LOAD_SHIFT)
+
+// clock ticks each hart has spent running a process, or idle.
+struct cpuinfo {
+  uint64 busy;
+  uint64 idle;
+};
+
 struct sysinfo {
   uint64 freemem;   // amount of free memory (bytes)
   uint64 nproc;     // number of process
+
+  // version 1
+  uint64 version;     // SYSINFO_VERSION of the kernel
+  uint64 ticks;       // clock ticks since boot
+  uint64 nrunnable;   // processes waiting for a hart
+  uint64 loadavg[3];  // 1, 5 and 15 second averages of the
+                      // number of runnable and running processes
+  uint64 ncpu;        // harts running; cpu[] entries in use
+  struct cpuinfo cpu[NCPU];
+  uint64 bhit;        // buffer cache hits
+  uint64 bmiss;       // buffer cache misses
+  uint64 diskread;    // disk reads, in blocks
+  uint64 diskwrite;   // disk writes, in blocks
+  uint64 logcommit;   // log transactions committed
+  uint64 piperead;    // bytes read from pipes
+  uint64 pipewrite;   // bytes written to pipes
+
+  // version 2
+  uint64 nbuf;        // buffers in the buffer cache
+
+  // version 3
+  uint64 readahead;   // disk reads started ahead of need, in blocks
+
+  // version 4
+  uint64 diskreq;     // disk requests; adjacent blocks share one
+
+  // version 5
+  uint64 diskintr;    // disk interrupts
+  uint64 disknotify;  // times the disk was told of new requests
 };
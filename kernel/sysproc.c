@@ -7,6 +7,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "sysinfo.h"
+#include "trace.h"
 
 uint64
 sys_exit(void)
@@ -36,7 +37,112 @@ sys_wait(void)
   uint64 p;
   if (argaddr(0, &p) < 0)
     return -1;
-  return wait(p);
+  return wait(p, 0);
+}
+
+uint64
+sys_wait3(void)
+{
+  uint64 p, ru;
+  if (argaddr(0, &p) < 0 || argaddr(1, &ru) < 0)
+    return -1;
+  return wait(p, ru);
+}
+
+uint64
+sys_getrusage(void)
+{
+  int who;
+  uint64 ru;
+  if (argint(0, &who) < 0 || argaddr(1, &ru) < 0)
+    return -1;
+  return getrusage(who, ru);
+}
+
+uint64
+sys_clone(void)
+{
+  uint64 fcn, arg, stack;
+
+  if (argaddr(0, &fcn) < 0 || argaddr(1, &arg) < 0 || argaddr(2, &stack) < 0)
+    return -1;
+  return clone(fcn, arg, stack);
+}
+
+uint64
+sys_join(void)
+{
+  int tid;
+  uint64 p;
+
+  if (argint(0, &tid) < 0 || argaddr(1, &p) < 0)
+    return -1;
+  return join(tid, p);
+}
+
+uint64
+sys_futex_wait(void)
+{
+  uint64 addr;
+  int val;
+
+  if (argaddr(0, &addr) < 0 || argint(1, &val) < 0)
+    return -1;
+  return futex_wait(addr, val);
+}
+
+uint64
+sys_futex_wake(void)
+{
+  uint64 addr;
+  int n;
+
+  if (argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return futex_wake(addr, n);
+}
+
+uint64
+sys_sched_setaffinity(void)
+{
+  int pid;
+  uint64 mask;
+
+  if (argint(0, &pid) < 0 || argaddr(1, &mask) < 0)
+    return -1;
+  return sched_setaffinity(pid, mask);
+}
+
+uint64
+sys_sched_getaffinity(void)
+{
+  int pid;
+
+  if (argint(0, &pid) < 0)
+    return -1;
+  return sched_getaffinity(pid);
+}
+
+uint64
+sys_schedstat(void)
+{
+  int pid;
+  uint64 addr;
+
+  if (argint(0, &pid) < 0 || argaddr(1, &addr) < 0)
+    return -1;
+  return schedstat(pid, addr);
+}
+
+uint64
+sys_sched_setrt(void)
+{
+  int pid, runtime, period, deadline;
+
+  if (argint(0, &pid) < 0 || argint(1, &runtime) < 0 ||
+      argint(2, &period) < 0 || argint(3, &deadline) < 0)
+    return -1;
+  return sched_setrt(pid, runtime, period, deadline);
 }
 
 uint64
@@ -109,23 +215,109 @@ sys_trace(void)
   {
     return -1;
   }
-  myproc()->mask = n;
+  tracemask(n);
   return 0;
 }
 
+uint64
+sys_traceread(void)
+{
+  uint64 addr;
+  int n;
+
+  if (argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return traceread(addr, n);
+}
+
+uint64
+sys_tracectl(void)
+{
+  uint64 addr;
+
+  if (argaddr(0, &addr) < 0)
+    return -1;
+  return tracectl(addr);
+}
+
+uint64
+sys_lockstat(void)
+{
+  uint64 addr;
+  int n;
+
+  if (argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return lockstat(addr, n);
+}
+
+uint64
+sys_diskctl(void)
+{
+  int cmd, arg;
+
+  if (argint(0, &cmd) < 0 || argint(1, &arg) < 0)
+    return -1;
+  return virtio_disk_ctl(cmd, arg);
+}
+
+uint64
+sys_scstat(void)
+{
+  int who;
+  uint64 addr;
+
+  if (argint(0, &who) < 0 || argaddr(1, &addr) < 0)
+    return -1;
+  return scstat_read(who, addr);
+}
+
+uint64
+sys_scprofile(void)
+{
+  int on;
+
+  if (argint(0, &on) < 0)
+    return -1;
+  return scprofile(on);
+}
+
+uint64
+sys_ring_setup(void)
+{
+  return ring_setup();
+}
+
+uint64
+sys_ring_enter(void)
+{
+  int n;
+
+  if (argint(0, &n) < 0)
+    return -1;
+  return ring_enter(n);
+}
+
 uint64
 sys_sysinfo(void){
   struct sysinfo info;
   struct proc *p = myproc();
-  info.freemem = freemem_num();
-  info.nproc = nproc_num();
   uint64 addr;
-  //取出传入的参数指针
-  if(argaddr(0, &addr) < 0){
+  int size;
+  //取出传入的参数指针和结构体大小
+  if(argaddr(0, &addr) < 0 || argint(1, &size) < 0 || size < 0){
     return -1;
   }
+  if(size > sizeof(info))
+    size = sizeof(info);
+  memset(&info, 0, sizeof(info));
+  info.freemem = freemem_num();
+  info.version = SYSINFO_VERSION;
+  info.ticks = ticks;
+  info.nbuf = bcachesize();
+  procinfo(&info);
   //将这个结构体的内容传入user space指针指向的内容
-  if(copyout(p->pagetable, addr, (char *)&info, sizeof(info)) < 0)
+  if(copyout(p->pagetable, addr, (char *)&info, size) < 0)
       return -1;
   return 0;
 
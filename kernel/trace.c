@@ -0,0 +1,282 @@
+//
+// System call tracing.
+//
+// Each hart appends the calls it traces to its own ring, with
+// interrupts off, so each ring has a single producer and needs
+// no lock. head is only written by the hart, tail only by a
+// reader. A full ring drops new events and counts them.
+// traceread() drains the rings in binary form.
+//
+// While no process is reading, traced calls are also printed
+// on the console, as the lab's trace command expects.
+//
+// tracectl() can instead send a process's events straight to
+// a file, which then slows the process down rather than
+// dropping events, and can narrow what is traced.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "syscall.h"
+#include "syscallnames.h"
+#include "trace.h"
+
+#define NTRACEEV 512  // events per hart; a power of two
+
+struct tracering {
+  struct traceev ev[NTRACEEV];
+  uint head;      // next slot to fill
+  uint tail;      // next slot to read
+  uint dropped;   // events lost since the last read
+};
+
+extern struct proc proc[NPROC+NKPROC];
+
+struct {
+  struct spinlock lock;  // serializes readers; protects p->tracefile
+  int reader;            // pid of the process reading, or 0
+  struct tracering ring[NCPU];
+} trace;
+
+void
+traceinit(void)
+{
+  initlock(&trace.lock, "trace");
+}
+
+// Write an event to p's trace file. Another process may
+// replace the file with tracectl() meanwhile, so hold a
+// reference to it while writing.
+static void
+tracewrite(struct proc *p, int num, uint64 *arg, uint64 ret)
+{
+  struct traceev e;
+  struct file *f;
+
+  acquire(&trace.lock);
+  if((f = p->tracefile) != 0)
+    filedup(f);
+  release(&trace.lock);
+  if(f == 0)
+    return;
+
+  e.time = r_time();
+  e.pid = p->pid;
+  e.num = num;
+  memmove(e.arg, arg, sizeof(e.arg));
+  e.ret = ret;
+  filewritek(f, (char *)&e, sizeof(e));
+  fileclose(f);
+}
+
+// Record that p's system call num, made with arguments
+// arg[0..5], returned ret.
+void
+tracesyscall(struct proc *p, int num, uint64 *arg, uint64 ret)
+{
+  struct tracering *r;
+  struct traceev *e;
+
+  if((p->traceflags & TRACE_FAILED) && (long)ret >= 0)
+    return;
+  if((p->traceflags & TRACE_ARGEQ) && arg[p->tracearg] != p->traceval)
+    return;
+
+  if(p->tracefile){
+    tracewrite(p, num, arg, ret);
+    return;
+  }
+
+  if(trace.reader == 0){
+    printf("%d: syscall %s -> %d\n", p->pid,
+           num < NELEM(syscallnames) && syscallnames[num] ? syscallnames[num] : "?",
+           ret);
+    return;
+  }
+
+  push_off();
+  r = &trace.ring[cpuid()];
+  if(r->head - r->tail == NTRACEEV){
+    __sync_fetch_and_add(&r->dropped, 1);
+  } else {
+    e = &r->ev[r->head % NTRACEEV];
+    e->time = r_time();
+    e->pid = p->pid;
+    e->num = num;
+    memmove(e->arg, arg, sizeof(e->arg));
+    e->ret = ret;
+    // publish the event only once it is complete.
+    __sync_synchronize();
+    r->head++;
+  }
+  pop_off();
+}
+
+// Copy traced events to user address addr, which has room
+// for n bytes, and make the caller the trace reader.
+// Returns the number of bytes copied; 0 if there are
+// no events, or -1 if n is negative.
+int
+traceread(uint64 addr, int n)
+{
+  struct proc *p = myproc();
+  struct tracering *r;
+  struct traceev drop;
+  int i, tot = 0;
+
+  if(n < 0)
+    return -1;
+  acquire(&trace.lock);
+  trace.reader = p->pid;
+  for(i = 0; i < NCPU; i++){
+    r = &trace.ring[i];
+    if(r->dropped > 0 && tot + sizeof(drop) <= n){
+      memset(&drop, 0, sizeof(drop));
+      drop.time = r_time();
+      drop.num = TRACE_DROPPED;
+      drop.ret = __sync_lock_test_and_set(&r->dropped, 0);
+      if(copyout(p->pagetable, addr + tot, (char *)&drop, sizeof(drop)) < 0)
+        break;
+      tot += sizeof(drop);
+    }
+    while(r->tail != r->head && tot + sizeof(struct traceev) <= n){
+      __sync_synchronize();
+      if(copyout(p->pagetable, addr + tot, (char *)&r->ev[r->tail % NTRACEEV],
+                 sizeof(struct traceev)) < 0)
+        goto out;
+      tot += sizeof(struct traceev);
+      // let the hart reuse the slot only after it was copied.
+      __sync_synchronize();
+      r->tail++;
+    }
+  }
+ out:
+  release(&trace.lock);
+  return tot;
+}
+
+// p is exiting; stop sending events to it, and
+// stop tracing it.
+void
+tracedetach(struct proc *p)
+{
+  struct file *f;
+
+  acquire(&trace.lock);
+  if(trace.reader == p->pid)
+    trace.reader = 0;
+  p->mask = 0;
+  f = p->tracefile;
+  p->tracefile = 0;
+  release(&trace.lock);
+  if(f)
+    fileclose(f);
+}
+
+// Set up tracing as described by the struct tracectl at
+// user address addr. Returns -1 if the process, fd or
+// argument number is bad.
+int
+tracectl(uint64 addr)
+{
+  struct proc *p = myproc();
+  struct proc *q;
+  struct tracectl tc;
+  struct file *f = 0, *old;
+  int pid, r;
+
+  if(copyin(p->pagetable, (char *)&tc, addr, sizeof(tc)) < 0)
+    return -1;
+  if((tc.flags & TRACE_ARGEQ) && (tc.arg < 0 || tc.arg >= 6))
+    return -1;
+  if(tc.mask != 0 && tc.fd >= 0){
+    acquire(&p->fdt->lock);
+    if(tc.fd >= NOFILE || (f = p->fdt->ofile[tc.fd]) == 0 || !f->writable){
+      release(&p->fdt->lock);
+      return -1;
+    }
+    filedup(f);
+    release(&p->fdt->lock);
+  }
+
+  pid = tc.pid ? tc.pid : p->pid;
+  for(q = proc; q < &proc[NPROC]; q++){
+    acquire(&q->lock);
+    if(q->pid == pid && q->state != UNUSED){
+      acquire(&trace.lock);
+      // exit() clears fdt before tracedetach(), so if fdt is
+      // set, tracedetach() has yet to close what we install.
+      if(q->fdt == 0){
+        old = f;
+        r = -1;
+      } else {
+        q->mask = tc.mask;
+        q->traceflags = tc.flags;
+        q->tracearg = tc.arg;
+        q->traceval = tc.val;
+        old = q->tracefile;
+        q->tracefile = f;
+        r = 0;
+      }
+      release(&trace.lock);
+      release(&q->lock);
+      if(old)
+        fileclose(old);
+      return r;
+    }
+    release(&q->lock);
+  }
+  if(f)
+    fileclose(f);
+  return -1;
+}
+
+// Trace the caller's calls in mask on the console or into the
+// rings, as the lab's trace() did, and its children's too.
+// Any file or filters tracectl() set are dropped.
+void
+tracemask(uint64 mask)
+{
+  struct proc *p = myproc();
+  struct file *old;
+
+  acquire(&p->lock);
+  acquire(&trace.lock);
+  p->mask = mask;
+  p->traceflags = TRACE_INHERIT;
+  p->tracearg = 0;
+  p->traceval = 0;
+  old = p->tracefile;
+  p->tracefile = 0;
+  release(&trace.lock);
+  release(&p->lock);
+  if(old)
+    fileclose(old);
+}
+
+// Start tracing fork() or clone()'s child np if its
+// parent p asked for TRACE_INHERIT.
+void
+tracefork(struct proc *np, struct proc *p)
+{
+  acquire(&trace.lock);
+  if(p->traceflags & TRACE_INHERIT){
+    np->mask = p->mask;
+    np->traceflags = p->traceflags;
+    np->tracearg = p->tracearg;
+    np->traceval = p->traceval;
+    np->tracefile = p->tracefile ? filedup(p->tracefile) : 0;
+  } else {
+    np->mask = 0;
+    np->traceflags = 0;
+    np->tracefile = 0;
+  }
+  release(&trace.lock);
+}
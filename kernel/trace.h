@@ -0,0 +1,29 @@
+// A traced system call, as stored in the per-CPU trace rings
+// and returned by traceread(). tools/tracedecode.py decodes
+// a stream of these on the host.
+struct traceev {
+  uint64 time;    // CLINT_MTIME cycles when the call returned
+  int pid;
+  int num;        // system call number, or TRACE_DROPPED
+  uint64 arg[6];  // a0..a5 on entry
+  uint64 ret;     // return value, or count of dropped events
+};
+
+// num of an event that reports how many events a hart
+// dropped because its ring was full.
+#define TRACE_DROPPED  -1
+
+// What tracectl() traces in one process.
+struct tracectl {
+  uint64 mask;    // bit n traces system call n; 0 stops tracing
+  int pid;        // process to trace, or 0 for the caller
+  int flags;      // TRACE_ flags below
+  int fd;         // caller's fd to write events to, or -1 for
+                  // the trace rings (or the console)
+  int arg;        // with TRACE_ARGEQ, which argument, 0..5,
+  uint64 val;     // must equal val
+};
+
+#define TRACE_INHERIT  1  // fork() and clone() children are traced too
+#define TRACE_FAILED   2  // only calls that return a negative value
+#define TRACE_ARGEQ    4  // only calls whose argument arg is val
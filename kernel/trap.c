@@ -5,6 +5,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "usyscall.h"
 
 struct spinlock tickslock;
 uint ticks;
@@ -47,6 +48,11 @@ usertrap(void)
 
   struct proc *p = myproc();
   
+  // charge the time since usertrapret() to user space.
+  uint64 now = r_time();
+  p->utime += now - p->tstamp;
+  p->tstamp = now;
+
   // save user program counter.
   p->trapframe->epc = r_sepc();
   
@@ -68,6 +74,8 @@ usertrap(void)
   } else if((which_dev = devintr()) != 0){
     // ok
   } else {
+    if(r_scause() == 12 || r_scause() == 13 || r_scause() == 15)
+      p->nfault++;
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
     p->killed = 1;
@@ -77,8 +85,10 @@ usertrap(void)
     exit(-1);
 
   // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
+  if(which_dev == 2){
+    sched_tick();
     yield();
+  }
 
   usertrapret();
 }
@@ -118,6 +128,14 @@ usertrapret(void)
   // set S Exception Program Counter to the saved user pc.
   w_sepc(p->trapframe->epc);
 
+  // ulib.c's uuptime() reads ticks from here.
+  p->usyscall->ticks = ticks;
+
+  // charge the time since usertrap() to the kernel.
+  uint64 now = r_time();
+  p->stime += now - p->tstamp;
+  p->tstamp = now;
+
   // tell trampoline.S the user page table to switch to.
   uint64 satp = MAKE_SATP(p->pagetable);
 
@@ -125,7 +143,7 @@ usertrapret(void)
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
   uint64 fn = TRAMPOLINE + (userret - trampoline);
-  ((void (*)(uint64,uint64))fn)(TRAPFRAME, satp);
+  ((void (*)(uint64,uint64))fn)(THREADFRAME(p->tslot), satp);
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -150,8 +168,10 @@ kerneltrap()
   }
 
   // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING)
+  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING){
+    sched_tick();
     yield();
+  }
 
   // the yield() may have caused some traps to occur,
   // so restore trap registers for use by kernelvec.S's sepc instruction.
@@ -164,6 +184,7 @@ clockintr()
 {
   acquire(&tickslock);
   ticks++;
+  loadtick();
   wakeup(&ticks);
   release(&tickslock);
 }
@@ -207,6 +228,7 @@ devintr()
     if(cpuid() == 0){
       clockintr();
     }
+    cputick();
     
     // acknowledge the software interrupt by clearing
     // the SSIP bit in sip.
@@ -0,0 +1,9 @@
+// The page mapped read-only at USYSCALL in every address space.
+// Threads share it, so pid is the pid of the process that
+// created the address space, which is what ugetpid() returns.
+struct usyscall {
+  int pid;            // Process ID
+  uint ticks;         // ticks, as of the last return to user space
+  uint64 freq;        // time CSR cycles per second
+  uint64 interval;    // time CSR cycles per tick
+};
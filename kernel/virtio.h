@@ -27,6 +27,7 @@
 #define VIRTIO_MMIO_INTERRUPT_STATUS	0x060 // read-only
 #define VIRTIO_MMIO_INTERRUPT_ACK	0x064 // write-only
 #define VIRTIO_MMIO_STATUS		0x070 // read/write
+#define VIRTIO_MMIO_CONFIG		0x100 // device-specific config space
 
 // status register bits, from qemu virtio_config.h
 #define VIRTIO_CONFIG_S_ACKNOWLEDGE	1
@@ -43,9 +44,13 @@
 #define VIRTIO_RING_F_INDIRECT_DESC 28
 #define VIRTIO_RING_F_EVENT_IDX     29
 
+// offset in the block device's config space of num_queues,
+// the number of queues it has with VIRTIO_BLK_F_MQ.
+#define VIRTIO_BLK_CONFIG_NUM_QUEUES 34
+
 // this many virtio descriptors.
 // must be a power of two.
-#define NUM 8
+#define NUM 64
 
 struct VRingDesc {
   uint64 addr;
@@ -55,6 +60,7 @@ struct VRingDesc {
 };
 #define VRING_DESC_F_NEXT  1 // chained with another descriptor
 #define VRING_DESC_F_WRITE 2 // device writes (vs read)
+#define VRING_DESC_F_INDIRECT 4 // addr is a table of descriptors
 
 struct VRingUsedElem {
   uint32 id;   // index of start of completed descriptor chain
@@ -65,8 +71,27 @@ struct VRingUsedElem {
 #define VIRTIO_BLK_T_IN  0 // read the disk
 #define VIRTIO_BLK_T_OUT 1 // write the disk
 
+// the first descriptor of a block operation points at one of these.
+struct virtio_blk_outhdr {
+  uint32 type; // VIRTIO_BLK_T_IN or ..._OUT
+  uint32 reserved;
+  uint64 sector;
+};
+
 struct UsedArea {
   uint16 flags;
   uint16 id;
   struct VRingUsedElem elems[NUM];
+  uint16 avail_event;  // VIRTIO_RING_F_EVENT_IDX: notify when
+                       // the avail index passes this
 };
+
+// the legacy queue layout, in bytes from its start: the
+// descriptor table, then the available ring, then the used
+// ring, at a page boundary. the available ring is flags, index,
+// NUM entries, and, with VIRTIO_RING_F_EVENT_IDX, used_event:
+// interrupt when the used index passes it.
+#define VRING_AVAIL (NUM*sizeof(struct VRingDesc))
+#define VRING_USED  PGROUNDUP(VRING_AVAIL + (3+NUM)*sizeof(uint16))
+#define USED_EVENT  (2+NUM)  // avail[] index of used_event
+#define VRING_SIZE  PGROUNDUP(VRING_USED + sizeof(struct UsedArea))
@@ -3,7 +3,7 @@
 // uses qemu's mmio interface to virtio.
 // qemu presents a "legacy" virtio interface.
 //
-// qemu ... -drive file=fs.img,if=none,format=raw,id=x0 -device virtio-blk-device,drive=x0,bus=virtio-mmio-bus.0
+// qemu ... -drive file=fs.img,if=none,format=raw,id=x0 -device virtio-blk-device,drive=x0,bus=virtio-mmio-bus.0,num-queues=N
 //
 
 #include "types.h"
@@ -16,43 +16,109 @@
 #include "fs.h"
 #include "buf.h"
 #include "virtio.h"
+#include "iosched.h"
+#include "diskctl.h"
 
 // the address of virtio mmio register r.
 #define R(r) ((volatile uint32 *)(VIRTIO0 + (r)))
 
-static struct disk {
- // memory for virtio descriptors &c for queue 0.
+// Operations wait in an ioqueue in front of the device, and
+// the I/O scheduler hands out runs of adjacent blocks in it,
+// which go to the device as one request of up to MAXSEG blocks,
+// each block its own data descriptor.
+#define MAXSEG 32   // blocks per request
+
+// One virtqueue. With VIRTIO_BLK_F_MQ, the device has a queue
+// for each hart, up to NCPU, so harts submitting at once don't
+// meet on a lock; otherwise every hart uses queue 0.
+struct vq {
+ // memory for virtio descriptors &c for the queue.
  // this is a global instead of allocated because it must
  // be multiple contiguous pages, which kalloc()
  // doesn't support, and page aligned.
-  char pages[2*PGSIZE];
+  char pages[VRING_SIZE];
   struct VRingDesc *desc;
   uint16 *avail;
   struct UsedArea *used;
 
+  int qnum;        // the device's number for this queue
+
   // our own book-keeping.
   char free[NUM];  // is a descriptor free?
-  uint16 used_idx; // we've looked this far in used[2..NUM].
+  uint16 used_idx; // we've reaped up to here; wraps like used->id
+  int nflight;     // requests the device has
+  int nwait;       // processes in waitfor()
 
   // track info about in-flight operations,
   // for use when completion interrupt arrives.
   // indexed by first descriptor index of chain.
   struct {
-    struct buf *b;
+    struct buf *b[MAXSEG];    // adjacent blocks, in order
+    char async[MAXSEG];       // call bdone() when finished
+    int n;
     char status;
   } info[NUM];
+
+  // the header of each operation, indexed like info[]. they
+  // can't be on the stack, since the submitter of an
+  // asynchronous operation doesn't wait for the device.
+  struct virtio_blk_outhdr ops[NUM];
+
+  // the descriptor chain of each operation, indexed like
+  // info[], if the device takes indirect descriptors.
+  struct VRingDesc indirect_desc[NUM][MAXSEG+2];
+
+  // operations the device hasn't been given yet.
+  struct ioqueue ioq;
   
-  struct spinlock vdisk_lock;
+  struct spinlock lock;
   
-} __attribute__ ((aligned (PGSIZE))) disk;
+} __attribute__ ((aligned (PGSIZE)));
+
+static struct disk {
+  struct vq vq[NCPU];
+  int nvq;         // queues in use
+  int indirect;    // device takes indirect descriptors
+  int eventidx;    // device takes VIRTIO_RING_F_EVENT_IDX
+  int poll;        // DISK_POLL: microseconds to poll before sleeping
+  int coalesce;    // DISK_COALESCE: use event indexes
+} disk;
+
+static void
+vq_init(struct vq *q, int qnum)
+{
+  initlock(&q->lock, "virtio_disk");
+  q->qnum = qnum;
+
+  *R(VIRTIO_MMIO_QUEUE_SEL) = qnum;
+  uint32 max = *R(VIRTIO_MMIO_QUEUE_NUM_MAX);
+  if(max == 0)
+    panic("virtio disk has no queue");
+  if(max < NUM)
+    panic("virtio disk max queue too short");
+  *R(VIRTIO_MMIO_QUEUE_NUM) = NUM;
+  memset(q->pages, 0, sizeof(q->pages));
+  *R(VIRTIO_MMIO_QUEUE_ALIGN) = PGSIZE;
+  *R(VIRTIO_MMIO_QUEUE_PFN) = ((uint64)q->pages) >> PGSHIFT;
+
+  // desc = pages -- num * VRingDesc
+  // avail = pages + VRING_AVAIL -- 2 * uint16, then num * uint16
+  // used = pages + VRING_USED -- 2 * uint16, then num * vRingUsedElem
+
+  q->desc = (struct VRingDesc *) q->pages;
+  q->avail = (uint16*)(q->pages + VRING_AVAIL);
+  q->used = (struct UsedArea *) (q->pages + VRING_USED);
+
+  for(int i = 0; i < NUM; i++)
+    q->free[i] = 1;
+  ioq_init(&q->ioq);
+}
 
 void
 virtio_disk_init(void)
 {
   uint32 status = 0;
 
-  initlock(&disk.vdisk_lock, "virtio_disk");
-
   if(*R(VIRTIO_MMIO_MAGIC_VALUE) != 0x74726976 ||
      *R(VIRTIO_MMIO_VERSION) != 1 ||
      *R(VIRTIO_MMIO_DEVICE_ID) != 2 ||
@@ -71,11 +137,23 @@ virtio_disk_init(void)
   features &= ~(1 << VIRTIO_BLK_F_RO);
   features &= ~(1 << VIRTIO_BLK_F_SCSI);
   features &= ~(1 << VIRTIO_BLK_F_CONFIG_WCE);
-  features &= ~(1 << VIRTIO_BLK_F_MQ);
   features &= ~(1 << VIRTIO_F_ANY_LAYOUT);
-  features &= ~(1 << VIRTIO_RING_F_EVENT_IDX);
-  features &= ~(1 << VIRTIO_RING_F_INDIRECT_DESC);
   *R(VIRTIO_MMIO_DRIVER_FEATURES) = features;
+  disk.indirect = (features >> VIRTIO_RING_F_INDIRECT_DESC) & 1;
+  disk.eventidx = (features >> VIRTIO_RING_F_EVENT_IDX) & 1;
+  disk.coalesce = disk.eventidx;
+
+  // with VIRTIO_BLK_F_MQ, the config space says how many
+  // queues there are; use one per hart.
+  disk.nvq = 1;
+  if(features & (1 << VIRTIO_BLK_F_MQ)){
+    disk.nvq = *(volatile uint16 *)(VIRTIO0 + VIRTIO_MMIO_CONFIG +
+                                    VIRTIO_BLK_CONFIG_NUM_QUEUES);
+    if(disk.nvq < 1)
+      disk.nvq = 1;
+    if(disk.nvq > NCPU)
+      disk.nvq = NCPU;
+  }
 
   // tell device that feature negotiation is complete.
   status |= VIRTIO_CONFIG_S_FEATURES_OK;
@@ -87,38 +165,31 @@ virtio_disk_init(void)
 
   *R(VIRTIO_MMIO_GUEST_PAGE_SIZE) = PGSIZE;
 
-  // initialize queue 0.
-  *R(VIRTIO_MMIO_QUEUE_SEL) = 0;
-  uint32 max = *R(VIRTIO_MMIO_QUEUE_NUM_MAX);
-  if(max == 0)
-    panic("virtio disk has no queue 0");
-  if(max < NUM)
-    panic("virtio disk max queue too short");
-  *R(VIRTIO_MMIO_QUEUE_NUM) = NUM;
-  memset(disk.pages, 0, sizeof(disk.pages));
-  *R(VIRTIO_MMIO_QUEUE_PFN) = ((uint64)disk.pages) >> PGSHIFT;
-
-  // desc = pages -- num * VRingDesc
-  // avail = pages + 0x40 -- 2 * uint16, then num * uint16
-  // used = pages + 4096 -- 2 * uint16, then num * vRingUsedElem
+  for(int i = 0; i < disk.nvq; i++)
+    vq_init(&disk.vq[i], i);
 
-  disk.desc = (struct VRingDesc *) disk.pages;
-  disk.avail = (uint16*)(((char*)disk.desc) + NUM*sizeof(struct VRingDesc));
-  disk.used = (struct UsedArea *) (disk.pages + PGSIZE);
+  // plic.c and trap.c arrange for interrupts from VIRTIO0_IRQ.
+}
 
-  for(int i = 0; i < NUM; i++)
-    disk.free[i] = 1;
+// the queue of the hart we're running on.
+static struct vq*
+myvq(void)
+{
+  int id;
 
-  // plic.c and trap.c arrange for interrupts from VIRTIO0_IRQ.
+  push_off();
+  id = cpuid();
+  pop_off();
+  return &disk.vq[id % disk.nvq];
 }
 
 // find a free descriptor, mark it non-free, return its index.
 static int
-alloc_desc()
+alloc_desc(struct vq *vq)
 {
   for(int i = 0; i < NUM; i++){
-    if(disk.free[i]){
-      disk.free[i] = 0;
+    if(vq->free[i]){
+      vq->free[i] = 0;
       return i;
     }
   }
@@ -127,144 +198,401 @@ alloc_desc()
 
 // mark a descriptor as free.
 static void
-free_desc(int i)
+free_desc(struct vq *vq, int i)
 {
   if(i >= NUM)
     panic("virtio_disk_intr 1");
-  if(disk.free[i])
+  if(vq->free[i])
     panic("virtio_disk_intr 2");
-  disk.desc[i].addr = 0;
-  disk.free[i] = 1;
-  wakeup(&disk.free[0]);
+  vq->desc[i].addr = 0;
+  vq->free[i] = 1;
 }
 
 // free a chain of descriptors.
 static void
-free_chain(int i)
+free_chain(struct vq *vq, int i)
 {
   while(1){
-    free_desc(i);
-    if(disk.desc[i].flags & VRING_DESC_F_NEXT)
-      i = disk.desc[i].next;
+    free_desc(vq, i);
+    if(vq->desc[i].flags & VRING_DESC_F_NEXT)
+      i = vq->desc[i].next;
     else
       break;
   }
 }
 
+// allocate n descriptors, or none if there aren't n free.
 static int
-alloc3_desc(int *idx)
+allocn_desc(struct vq *vq, int *idx, int n)
 {
-  for(int i = 0; i < 3; i++){
-    idx[i] = alloc_desc();
+  for(int i = 0; i < n; i++){
+    idx[i] = alloc_desc(vq);
     if(idx[i] < 0){
       for(int j = 0; j < i; j++)
-        free_desc(idx[j]);
+        free_desc(vq, idx[j]);
       return -1;
     }
   }
   return 0;
 }
 
-void
-virtio_disk_rw(struct buf *b, int write)
+// the most blocks the next request can carry, given the
+// free descriptors.
+static int
+room(struct vq *vq)
 {
-  uint64 sector = b->blockno * (BSIZE / 512);
-
-  acquire(&disk.vdisk_lock);
+  int n = 0;
 
-  // the spec says that legacy block operations use three
-  // descriptors: one for type/reserved/sector, one for
-  // the data, one for a 1-byte status result.
+  for(int i = 0; i < NUM; i++)
+    n += vq->free[i];
+  if(disk.indirect)
+    return n > 0 ? MAXSEG : 0;
+  return n - 2 < MAXSEG ? n - 2 : MAXSEG;
+}
 
-  // allocate the three descriptors.
-  int idx[3];
-  while(1){
-    if(alloc3_desc(idx) == 0) {
-      break;
-    }
-    sleep(&disk.free[0], &disk.vdisk_lock);
+// Hand the n queued blocks at e, which are adjacent on the
+// disk and all go the same way, to the device as a single
+// request, and return without waiting. The caller has
+// checked room(), and holds vq->lock.
+static void
+submit(struct vq *vq, struct ioreq *e, int n)
+{
+  int write = e[0].write;
+  int nd = n + 2;
+  int idx[MAXSEG+2], head;
+  struct VRingDesc *d;
+
+  // the spec says that legacy block operations use a
+  // descriptor for type/reserved/sector, one for each
+  // piece of the data, and one for a 1-byte status result.
+  // with indirect descriptors, the chain lives in a table
+  // of our own, and takes a single descriptor in the ring.
+  if(disk.indirect){
+    if(allocn_desc(vq, &head, 1) < 0)
+      panic("virtio_disk submit");
+    d = vq->indirect_desc[head];
+    vq->desc[head].addr = (uint64) d;
+    vq->desc[head].len = nd * sizeof(struct VRingDesc);
+    vq->desc[head].flags = VRING_DESC_F_INDIRECT;
+    vq->desc[head].next = 0;
+    for(int i = 0; i < nd; i++)
+      idx[i] = i;
+  } else {
+    if(allocn_desc(vq, idx, nd) < 0)
+      panic("virtio_disk submit");
+    head = idx[0];
+    d = vq->desc;
   }
-  
-  // format the three descriptors.
+
+  // format the descriptors.
   // qemu's virtio-blk.c reads them.
 
-  struct virtio_blk_outhdr {
-    uint32 type;
-    uint32 reserved;
-    uint64 sector;
-  } buf0;
+  struct virtio_blk_outhdr *buf0 = &vq->ops[head];
 
   if(write)
-    buf0.type = VIRTIO_BLK_T_OUT; // write the disk
-  else
-    buf0.type = VIRTIO_BLK_T_IN; // read the disk
-  buf0.reserved = 0;
-  buf0.sector = sector;
-
-  // buf0 is on a kernel stack, which is not direct mapped,
-  // thus the call to kvmpa().
-  disk.desc[idx[0]].addr = (uint64) kvmpa((uint64) &buf0);
-  disk.desc[idx[0]].len = sizeof(buf0);
-  disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
-  disk.desc[idx[0]].next = idx[1];
-
-  disk.desc[idx[1]].addr = (uint64) b->data;
-  disk.desc[idx[1]].len = BSIZE;
-  if(write)
-    disk.desc[idx[1]].flags = 0; // device reads b->data
+    buf0->type = VIRTIO_BLK_T_OUT; // write the disk
   else
-    disk.desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes b->data
-  disk.desc[idx[1]].flags |= VRING_DESC_F_NEXT;
-  disk.desc[idx[1]].next = idx[2];
+    buf0->type = VIRTIO_BLK_T_IN; // read the disk
+  buf0->reserved = 0;
+  buf0->sector = e[0].b->blockno * (BSIZE / 512);
+
+  d[idx[0]].addr = (uint64) buf0;
+  d[idx[0]].len = sizeof(*buf0);
+  d[idx[0]].flags = VRING_DESC_F_NEXT;
+  d[idx[0]].next = idx[1];
+
+  for(int i = 0; i < n; i++){
+    d[idx[i+1]].addr = (uint64) e[i].b->data;
+    d[idx[i+1]].len = BSIZE;
+    if(write)
+      d[idx[i+1]].flags = 0; // device reads b->data
+    else
+      d[idx[i+1]].flags = VRING_DESC_F_WRITE; // device writes b->data
+    d[idx[i+1]].flags |= VRING_DESC_F_NEXT;
+    d[idx[i+1]].next = idx[i+2];
 
-  disk.info[idx[0]].status = 0;
-  disk.desc[idx[2]].addr = (uint64) &disk.info[idx[0]].status;
-  disk.desc[idx[2]].len = 1;
-  disk.desc[idx[2]].flags = VRING_DESC_F_WRITE; // device writes the status
-  disk.desc[idx[2]].next = 0;
+    // record struct buf for virtio_disk_intr().
+    vq->info[head].b[i] = e[i].b;
+    vq->info[head].async[i] = e[i].async;
+  }
+  vq->info[head].n = n;
 
-  // record struct buf for virtio_disk_intr().
-  b->disk = 1;
-  disk.info[idx[0]].b = b;
+  vq->info[head].status = 0;
+  d[idx[nd-1]].addr = (uint64) &vq->info[head].status;
+  d[idx[nd-1]].len = 1;
+  d[idx[nd-1]].flags = VRING_DESC_F_WRITE; // device writes the status
+  d[idx[nd-1]].next = 0;
+
+  cpustat(write ? CS_DISKWRITE : CS_DISKREAD, n);
+  cpustat(CS_DISKREQ, 1);
 
   // avail[0] is flags
   // avail[1] tells the device how far to look in avail[2...].
   // avail[2...] are desc[] indices the device should process.
   // we only tell device the first index in our chain of descriptors.
-  disk.avail[2 + (disk.avail[1] % NUM)] = idx[0];
+  vq->avail[2 + (vq->avail[1] % NUM)] = head;
+  __sync_synchronize();
+  vq->avail[1] = vq->avail[1] + 1;
+  vq->nflight++;
+}
+
+// Does the device want to hear that the avail index moved on
+// from old? With event indexes, the device says where in the
+// avail ring it will next look on its own, and only needs a
+// notify if we went past that; otherwise it is still busy
+// with earlier requests and will find the new ones.
+static int
+needkick(struct vq *vq, uint16 old)
+{
+  uint16 new = vq->avail[1];
+  uint16 event;
+
+  if(!disk.coalesce)
+    return 1;
+  __sync_synchronize();
+  event = *(volatile uint16 *)&vq->used->avail_event;
+  return (uint16)(new - event - 1) < (uint16)(new - old);
+}
+
+// Tell the device when to interrupt next: after the next
+// completion if anyone is waiting for one, else only once
+// 3/4 of the requests in flight are done, so that a burst
+// of read-ahead or write-back costs a few interrupts rather
+// than one each. Returns 1 if completions have come in that
+// we haven't reaped, and which the new setting may have
+// missed. A device with event indexes goes by used_event
+// even with coalescing off, so it is always kept up to date.
+// Caller holds vq->lock.
+static int
+arm(struct vq *vq)
+{
+  int k = 1;
+
+  if(!disk.eventidx)
+    return 0;
+  if(disk.coalesce && vq->nwait == 0 && vq->nflight * 3 / 4 > 1)
+    k = vq->nflight * 3 / 4;
+  vq->avail[USED_EVENT] = vq->used_idx + k - 1;
   __sync_synchronize();
-  disk.avail[1] = disk.avail[1] + 1;
+  return *(volatile uint16 *)&vq->used->id != vq->used_idx;
+}
+
+// Hand as much of the queue to the device as there are
+// descriptors for, in the order the I/O scheduler picks,
+// each run of adjacent blocks that go the same way as one
+// request. Whatever doesn't fit stays queued until
+// virtio_disk_intr() frees descriptors.
+// Caller holds vq->lock.
+static void
+dispatch(struct vq *vq)
+{
+  struct ioreq run[MAXSEG];
+  int n, max, done = 0;
+  uint16 old = vq->avail[1];
+
+  while((max = room(vq)) > 0 && (n = ioq_next(&vq->ioq, run, max)) > 0){
+    submit(vq, run, n);
+    done = 1;
+  }
+  if(!done)
+    return;
+  wakeup(&vq->ioq);
+
+  if(needkick(vq, old)){
+    *R(VIRTIO_MMIO_QUEUE_NOTIFY) = vq->qnum; // value is queue number
+    cpustat(CS_DISKNOTIFY, 1);
+  }
+}
+
+// Add b to the queue, and set b->disk until the device is
+// done with it. Caller holds vq->lock.
+static void
+enqueue(struct vq *vq, struct buf *b, int write, int async)
+{
+  while(vq->ioq.n == NIOREQ){
+    dispatch(vq);
+    if(vq->ioq.n == NIOREQ)
+      sleep(&vq->ioq, &vq->lock);
+  }
+  ioq_add(&vq->ioq, b, write, async);
+  b->disk = 1;
+  b->vq = vq - disk.vq;
+}
+
+// Reap the requests the device has finished: clear each
+// block's b->disk, wake its waiters, and drop the reference
+// of an asynchronous operation. Then hand the device more
+// of the queue, and say when to interrupt next.
+// Caller holds vq->lock.
+static void
+complete(struct vq *vq)
+{
+again:
+  while(vq->used_idx != *(volatile uint16 *)&vq->used->id){
+    int id = vq->used->elems[vq->used_idx % NUM].id;
+
+    if(vq->info[id].status != 0)
+      panic("virtio_disk_intr status");
 
-  *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
+    for(int i = 0; i < vq->info[id].n; i++){
+      struct buf *b = vq->info[id].b[i];
+      b->disk = 0;   // disk is done with buf
+      wakeup(b);
+      if(vq->info[id].async[i])
+        bdone(b);
+      vq->info[id].b[i] = 0;
+    }
+    vq->info[id].n = 0;
+    free_chain(vq, id);
+    vq->nflight--;
 
-  // Wait for virtio_disk_intr() to say request has finished.
-  while(b->disk == 1) {
-    sleep(b, &disk.vdisk_lock);
+    vq->used_idx++;
   }
 
-  disk.info[idx[0]].b = 0;
-  free_chain(idx[0]);
+  // the device has room again.
+  dispatch(vq);
+  if(arm(vq))
+    goto again;
+}
 
-  release(&disk.vdisk_lock);
+// Is b waiting for the device on vq? Once b has moved on to
+// another queue, the operation it had on vq is over.
+static int
+busy(struct vq *vq, struct buf *b)
+{
+  return b->disk == 1 && b->vq == vq - disk.vq;
+}
+
+// Wait for the device to finish with b. With polling on,
+// first watch the used ring for up to disk.poll microseconds
+// and reap completions here, which saves the sleep and the
+// wakeup when the disk answers quickly. The interrupt still
+// arrives, and finds nothing left to do.
+// Caller holds vq->lock.
+static void
+waitfor(struct vq *vq, struct buf *b)
+{
+  uint64 t0 = r_time();
+  uint64 limit = (uint64)disk.poll * (CLINT_FREQ / 1000000);
+
+  while(busy(vq, b) && r_time() - t0 < limit){
+    release(&vq->lock);
+    while(*(volatile uint16 *)&vq->used->id == vq->used_idx &&
+          r_time() - t0 < limit)
+      ;
+    acquire(&vq->lock);
+    complete(vq);
+  }
+  // with event indexes, complete() asks for an interrupt
+  // on the next completion while anyone waits.
+  vq->nwait++;
+  complete(vq);
+  while(busy(vq, b)) {
+    sleep(b, &vq->lock);
+  }
+  vq->nwait--;
 }
 
 void
-virtio_disk_intr()
+virtio_disk_rw(struct buf *b, int write)
 {
-  acquire(&disk.vdisk_lock);
+  struct vq *vq = myvq();
 
-  while((disk.used_idx % NUM) != (disk.used->id % NUM)){
-    int id = disk.used->elems[disk.used_idx].id;
+  acquire(&vq->lock);
+  enqueue(vq, b, write, 0);
+  dispatch(vq);
 
-    if(disk.info[id].status != 0)
-      panic("virtio_disk_intr status");
-    
-    disk.info[id].b->disk = 0;   // disk is done with buf
-    wakeup(disk.info[id].b);
+  // Wait for the device to say request has finished.
+  waitfor(vq, b);
+
+  release(&vq->lock);
+}
+
+// Queue a read or write of b without waiting for it. The
+// operation holds a reference to b, which virtio_disk_intr()
+// drops with bdone() once the device is done. The device
+// doesn't see it until virtio_disk_kick(), or until somebody
+// waits for a block, so that a caller starting several
+// operations in a row gives them a chance to merge.
+void
+virtio_disk_start(struct buf *b, int write)
+{
+  struct vq *vq = myvq();
+
+  acquire(&vq->lock);
+  enqueue(vq, b, write, 1);
+  release(&vq->lock);
+}
 
-    disk.used_idx = (disk.used_idx + 1) % NUM;
+// Hand the operations queued by virtio_disk_start() to the
+// device.
+void
+virtio_disk_kick(void)
+{
+  for(int i = 0; i < disk.nvq; i++){
+    struct vq *vq = &disk.vq[i];
+    acquire(&vq->lock);
+    dispatch(vq);
+    release(&vq->lock);
   }
-  *R(VIRTIO_MMIO_INTERRUPT_ACK) = *R(VIRTIO_MMIO_INTERRUPT_STATUS) & 0x3;
+}
 
-  release(&disk.vdisk_lock);
+// Wait for an operation on b started by virtio_disk_start().
+// If it is over and somebody has started another on a different
+// queue, b->vq may be stale, and then busy() says we're done.
+void
+virtio_disk_wait(struct buf *b)
+{
+  struct vq *vq = &disk.vq[b->vq];
+
+  acquire(&vq->lock);
+  if(busy(vq, b))
+    dispatch(vq);
+  waitfor(vq, b);
+  release(&vq->lock);
+}
+
+// Set knob cmd, from diskctl.h, to arg, unless arg is -1,
+// and return its old value, or -1 if there is no such knob.
+int
+virtio_disk_ctl(int cmd, int arg)
+{
+  int old;
+
+  switch(cmd){
+  case DISK_POLL:
+    old = disk.poll;
+    if(arg >= 0)
+      disk.poll = arg;
+    break;
+  case DISK_SCHED:
+    old = iosched_set(arg);
+    break;
+  case DISK_COALESCE:
+    if(!disk.eventidx)
+      return -1;
+    old = disk.coalesce;
+    if(arg >= 0)
+      disk.coalesce = arg != 0;
+    break;
+  default:
+    old = -1;
+  }
+  return old;
+}
+
+// The device has one interrupt for all its queues, so look
+// at each of them. The interrupt is acknowledged first, so a
+// completion that comes in while we look raises a new one.
+void
+virtio_disk_intr()
+{
+  cpustat(CS_DISKINTR, 1);
+  *R(VIRTIO_MMIO_INTERRUPT_ACK) = *R(VIRTIO_MMIO_INTERRUPT_STATUS) & 0x3;
+  for(int i = 0; i < disk.nvq; i++){
+    struct vq *vq = &disk.vq[i];
+    acquire(&vq->lock);
+    complete(vq);
+    release(&vq->lock);
+  }
 }
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+#
+# Decode system call traces written by user/tracedump.
+#
+#   tracedecode.py trace.bin
+#   tracedecode.py fs.img /trace.out
+#
+# The second form reads the trace file straight out of an
+# xv6 file system image, after qemu has exited.
+
+import os
+import re
+import struct
+import sys
+
+CLINT_FREQ = 10000000       # kernel/memlayout.h
+TRACE_DROPPED = -1          # kernel/trace.h
+EVENT = struct.Struct('<QiiQQQQQQQ')  # struct traceev
+
+BSIZE = 1024                # kernel/fs.h
+FSMAGIC = 0x10203040
+NDIRECT = 12
+DINODE = struct.Struct('<hhhhI13I')
+DIRENT = struct.Struct('<H14s')
+ROOTINO = 1
+
+def syscall_names():
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        '..', 'kernel', 'syscall.h')
+    names = {}
+    with open(path) as f:
+        for line in f:
+            m = re.match(r'#define\s+SYS_(\w+)\s+(\d+)', line)
+            if m:
+                names[int(m.group(2))] = m.group(1)
+    return names
+
+class FS:
+    def __init__(self, img):
+        self.img = img
+        sb = struct.unpack_from('<8I', img, BSIZE)
+        if sb[0] != FSMAGIC:
+            raise ValueError('not an xv6 file system')
+        self.inodestart = sb[6]
+
+    def block(self, b):
+        return self.img[b*BSIZE:(b+1)*BSIZE]
+
+    def inode(self, inum):
+        ipb = BSIZE // DINODE.size
+        b = self.block(inum // ipb + self.inodestart)
+        d = DINODE.unpack_from(b, (inum % ipb) * DINODE.size)
+        return d[4], d[5:]
+
+    def read(self, inum):
+        size, addrs = self.inode(inum)
+        blocks = list(addrs[:NDIRECT])
+        if addrs[NDIRECT]:
+            ind = self.block(addrs[NDIRECT])
+            blocks += struct.unpack('<%dI' % (BSIZE // 4), ind)
+        data = b''.join(self.block(b) for b in blocks if b)
+        return data[:size]
+
+    def lookup(self, path):
+        inum = ROOTINO
+        for name in [p for p in path.split('/') if p]:
+            d = self.read(inum)
+            for off in range(0, len(d), DIRENT.size):
+                n, nm = DIRENT.unpack_from(d, off)
+                if n and nm.rstrip(b'\0').decode() == name:
+                    inum = n
+                    break
+            else:
+                raise FileNotFoundError(path)
+        return inum
+
+def main(argv):
+    if len(argv) not in (2, 3):
+        sys.stderr.write('usage: %s trace | %s fs.img path\n' % (argv[0], argv[0]))
+        return 1
+    with open(argv[1], 'rb') as f:
+        data = f.read()
+    if len(argv) == 3:
+        fs = FS(data)
+        data = fs.read(fs.lookup(argv[2]))
+
+    names = syscall_names()
+    events = [EVENT.unpack_from(data, off)
+              for off in range(0, len(data) - EVENT.size + 1, EVENT.size)]
+    # each hart has its own ring; merge them.
+    events.sort(key=lambda e: e[0])
+    t0 = events[0][0] if events else 0
+    for e in events:
+        time, pid, num, args, ret = e[0], e[1], e[2], e[3:9], e[9]
+        us = (time - t0) * 1000000 // CLINT_FREQ
+        if num == TRACE_DROPPED:
+            print('%10d  -- %d events dropped' % (us, ret))
+            continue
+        if ret >= 1 << 63:
+            ret -= 1 << 64
+        print('%10d %4d %s(%s) = %d' % (us, pid, names.get(num, '#%d' % num),
+                                       ', '.join('0x%x' % a for a in args[:3]), ret))
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,93 @@
+#include "kernel/types.h"
+#include "kernel/schedstat.h"
+#include "user/user.h"
+
+void
+sstat(struct schedstat *st)
+{
+  if(schedstat(0, st) < 0){
+    printf("affinitytest: FAIL schedstat failed\n");
+    exit(1);
+  }
+}
+
+// burn cpu across many timer interrupts.
+void
+spin()
+{
+  for(volatile int i = 0; i < 50000000; i++)
+    ;
+}
+
+//
+// a process pinned to one hart only runs there.
+//
+void
+testpin()
+{
+  struct schedstat st;
+  uint64 nmigrate;
+
+  if(sched_setaffinity(0, 1) < 0){
+    printf("affinitytest: FAIL sched_setaffinity failed\n");
+    exit(1);
+  }
+  if(sched_getaffinity(0) != 1){
+    printf("affinitytest: FAIL affinity is %p instead of 1\n", sched_getaffinity(0));
+    exit(1);
+  }
+  sstat(&st);
+  if(st.lastcpu != 0){
+    printf("affinitytest: FAIL running on hart %d instead of 0\n", st.lastcpu);
+    exit(1);
+  }
+  nmigrate = st.nmigrate;
+  spin();
+  sstat(&st);
+  if(st.lastcpu != 0 || st.nmigrate != nmigrate){
+    printf("affinitytest: FAIL pinned process migrated %d times\n",
+           st.nmigrate - nmigrate);
+    exit(1);
+  }
+}
+
+//
+// affinity is inherited, and masks without running harts are refused.
+//
+void
+testinherit()
+{
+  int pid, status;
+
+  if(sched_setaffinity(0, 0) != -1 || sched_setaffinity(0, 1L << 62) != -1){
+    printf("affinitytest: FAIL accepted a mask with no running harts\n");
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("affinitytest: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exit(sched_getaffinity(0) == 1 ? 0 : 1);
+  }
+  wait(&status);
+  if(status != 0){
+    printf("affinitytest: FAIL child did not inherit affinity\n");
+    exit(1);
+  }
+  if(sched_getaffinity(-1) != -1){
+    printf("affinitytest: FAIL affinity of a bad pid\n");
+    exit(1);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf("affinitytest: start\n");
+  testpin();
+  testinherit();
+  printf("affinitytest: OK\n");
+  exit(0);
+}
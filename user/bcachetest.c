@@ -0,0 +1,173 @@
+// Read private files through the buffer cache from 1 up to 8
+// harts at once, one process pinned to each, check that every
+// block comes back right, and report throughput and how often
+// a buffer cache lock was contended. With per-bucket locks,
+// harts reading different blocks rarely meet, so the share of
+// contended acquires should fall rather than grow with harts.
+//
+// usage: bcachetest [ticks]
+//
+// Run qemu with CPUS=8 to go up to 8 harts.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "kernel/lockstat.h"
+#include "kernel/sysinfo.h"
+#include "user/user.h"
+
+#define MAXHART 8
+#define FILESIZE 2048  // two blocks per file
+#define NLOCK 1024
+
+struct lockstat st[NLOCK];
+
+// what each process reports, in a single write so that
+// reports don't interleave in the pipe.
+struct result {
+  uint64 hart;
+  uint64 count;
+  uint64 bad;
+};
+
+void
+fail(char *why)
+{
+  printf("bcachetest: FAIL %s\n", why);
+  exit(1);
+}
+
+char*
+name(int i)
+{
+  static char buf[8];
+
+  strcpy(buf, "bct0");
+  buf[3] = '0' + i;
+  return buf;
+}
+
+void
+setup(int nhart)
+{
+  char buf[512];
+  int fd, i, j;
+
+  for(i = 0; i < nhart; i++){
+    if((fd = open(name(i), O_CREATE|O_TRUNC|O_WRONLY)) < 0)
+      fail("create");
+    memset(buf, 'a' + i, sizeof(buf));
+    for(j = 0; j < FILESIZE; j += sizeof(buf))
+      if(write(fd, buf, sizeof(buf)) != sizeof(buf))
+        fail("write");
+    close(fd);
+  }
+}
+
+// contended and total acquires of the buffer cache's locks.
+void
+bcachelocks(uint64 *ncontend, uint64 *nacquire)
+{
+  int n, i;
+
+  if((n = lockstat(st, NLOCK)) < 0)
+    fail("lockstat");
+  *ncontend = *nacquire = 0;
+  for(i = 0; i < n; i++){
+    if(st[i].kind == LOCK_SPIN && (strcmp(st[i].name, "bcache") == 0 ||
+       strcmp(st[i].name, "bcache.bucket") == 0)){
+      *ncontend += st[i].ncontend;
+      *nacquire += st[i].nacquire;
+    }
+  }
+}
+
+void
+run(int nhart, int ticks)
+{
+  int fds[2], i, j, pid, start, fd;
+  uint64 total, ncontend, nacquire;
+  char buf[512];
+
+  if(pipe(fds) < 0)
+    fail("pipe");
+  lockstat(0, 0);
+  // start everyone on the same tick.
+  start = uptime() + 2;
+  for(i = 0; i < nhart; i++){
+    pid = fork();
+    if(pid < 0)
+      fail("fork");
+    if(pid == 0){
+      struct result r = { i, 0, 0 };
+      if(sched_setaffinity(0, 1L << i) < 0)
+        fail("cannot pin");
+      if((fd = open(name(i), O_RDONLY)) < 0)
+        fail("open");
+      while(uuptime() < start)
+        ;
+      while(uuptime() < start + ticks){
+        if(read(fd, buf, sizeof(buf)) != sizeof(buf)){
+          close(fd);
+          if((fd = open(name(i), O_RDONLY)) < 0)
+            fail("reopen");
+          continue;
+        }
+        for(j = 0; j < sizeof(buf); j++)
+          if(buf[j] != 'a' + i)
+            r.bad++;
+        r.count++;
+      }
+      write(fds[1], &r, sizeof(r));
+      exit(0);
+    }
+  }
+  close(fds[1]);
+  total = 0;
+  for(i = 0; i < nhart; i++){
+    struct result r;
+    if(read(fds[0], &r, sizeof(r)) != sizeof(r) || r.hart >= nhart)
+      fail("lost a result");
+    if(r.bad)
+      fail("wrong data");
+    total += r.count;
+  }
+  close(fds[0]);
+  for(i = 0; i < nhart; i++){
+    int status;
+    wait(&status);
+    if(status != 0)
+      fail("child failed");
+  }
+
+  bcachelocks(&ncontend, &nacquire);
+  printf("%d harts: %d reads/tick, %d of %d bcache lock acquires contended (%d per 10000)\n",
+         nhart, (int)(total / ticks), (int)ncontend, (int)nacquire,
+         nacquire ? (int)(ncontend * 10000 / nacquire) : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct sysinfo info;
+  int ticks = 10, nhart, i;
+
+  if(argc > 1)
+    ticks = atoi(argv[1]);
+  if(argc > 2 || ticks < 1){
+    fprintf(2, "Usage: bcachetest [ticks]\n");
+    exit(1);
+  }
+  if(sysinfo(&info, sizeof(info)) < 0 || info.version < 1)
+    fail("sysinfo");
+  nhart = info.ncpu < MAXHART ? info.ncpu : MAXHART;
+
+  printf("bcachetest: start\n");
+  setup(nhart);
+  for(i = 1; i <= nhart; i++)
+    run(i, ticks);
+  for(i = 0; i < nhart; i++)
+    unlink(name(i));
+  printf("bcachetest: OK\n");
+  exit(0);
+}
@@ -0,0 +1,194 @@
+// Read files cold, a block at a time, while other processes
+// keep writing, so that the flusher's write-back competes with
+// the reads for the disk. Do it under each I/O scheduler policy,
+// and report the read latency and the write throughput. The
+// deadline policy puts reads ahead of write-back, so reads
+// should wait less under it than under noop.
+//
+// usage: iosbench [ticks]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/riscv.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/diskctl.h"
+#include "user/user.h"
+
+#define NREADER 2
+#define NWRITER 2
+#define RBLOCKS 48   // blocks in each reader's file
+#define WBLOCKS 32   // blocks in each writer's file
+
+// what each process reports, in a single write so that
+// reports don't interleave in the pipe.
+struct result {
+  uint64 writer;
+  uint64 count;   // blocks read or written
+  uint64 sum;     // reads: total cycles
+  uint64 max;     // reads: longest, in cycles
+};
+
+char buf[BSIZE];
+
+void
+fail(char *why)
+{
+  printf("iosbench: FAIL %s\n", why);
+  exit(1);
+}
+
+char*
+name(int writer, int i)
+{
+  static char n[8];
+
+  strcpy(n, "iosr0");
+  if(writer)
+    n[3] = 'w';
+  n[4] = '0' + i;
+  return n;
+}
+
+// push the buffer cache down to its minimum size.
+void
+dropcache(void)
+{
+  char *sz0 = sbrk(0);
+  int n;
+
+  for(n = 1024*1024; n >= PGSIZE; ){
+    if(sbrk(n) == (char*)-1)
+      n /= 2;
+  }
+  sbrk(-(sbrk(0) - sz0));
+}
+
+void
+run(char *what, int ticks)
+{
+  int fds[2], i, w, pid, start, fd, j;
+  uint64 nread = 0, sum = 0, max = 0, nwritten = 0;
+
+  // let the flusher write everything back, so the readers'
+  // blocks can leave the cache.
+  sleep(DIRTYAGE + 2);
+  dropcache();
+  if(pipe(fds) < 0)
+    fail("pipe");
+  start = uptime() + 2;
+  for(w = 0; w <= 1; w++){
+    for(i = 0; i < (w ? NWRITER : NREADER); i++){
+      pid = fork();
+      if(pid < 0)
+        fail("fork");
+      if(pid != 0)
+        continue;
+      struct result r = { w, 0, 0, 0 };
+      if(w){
+        // keep the flusher busy for the whole run.
+        memset(buf, 'A' + i, sizeof(buf));
+        while(uuptime() < start)
+          ;
+        while(uuptime() < start + ticks){
+          if((fd = open(name(1, i), O_CREATE|O_TRUNC|O_WRONLY)) < 0)
+            fail("create");
+          for(j = 0; j < WBLOCKS; j++){
+            if(write(fd, buf, sizeof(buf)) != sizeof(buf))
+              fail("write");
+            r.count++;
+          }
+          close(fd);
+        }
+      } else {
+        uint64 t0, t;
+        if((fd = open(name(0, i), O_RDONLY|O_RANDOM)) < 0)
+          fail("open");
+        // start once write-back is under way.
+        while(uuptime() < start + DIRTYAGE + 1)
+          ;
+        for(;;){
+          t0 = uclock();
+          if(read(fd, buf, sizeof(buf)) != sizeof(buf))
+            break;
+          t = uclock() - t0;
+          for(j = 0; j < sizeof(buf); j++)
+            if(buf[j] != 'a' + i)
+              fail("wrong data");
+          r.count++;
+          r.sum += t;
+          if(t > r.max)
+            r.max = t;
+        }
+        close(fd);
+      }
+      write(fds[1], &r, sizeof(r));
+      exit(0);
+    }
+  }
+  close(fds[1]);
+  for(i = 0; i < NREADER + NWRITER; i++){
+    struct result r;
+    if(read(fds[0], &r, sizeof(r)) != sizeof(r))
+      fail("lost a result");
+    if(r.writer){
+      nwritten += r.count;
+    } else {
+      nread += r.count;
+      sum += r.sum;
+      if(r.max > max)
+        max = r.max;
+    }
+  }
+  close(fds[0]);
+  for(i = 0; i < NREADER + NWRITER; i++){
+    int status;
+    wait(&status);
+    if(status != 0)
+      fail("child failed");
+  }
+  if(nread != NREADER * RBLOCKS)
+    fail("short read");
+
+  printf("%s: reads avg %d us, max %d us; writes %d KB/s\n", what,
+         (int)(sum * 1000000 / ufreq() / nread),
+         (int)(max * 1000000 / ufreq()),
+         (int)(nwritten * BSIZE / 1024 * 10 / ticks));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int ticks = 20, old, i, j, fd;
+
+  if(argc > 1)
+    ticks = atoi(argv[1]);
+  if(argc > 2 || ticks <= DIRTYAGE + 1){
+    fprintf(2, "Usage: iosbench [ticks], more than %d\n", DIRTYAGE + 1);
+    exit(1);
+  }
+  if((old = diskctl(DISK_SCHED, -1)) < 0)
+    fail("kernel has no I/O scheduler");
+
+  printf("iosbench: start\n");
+  for(i = 0; i < NREADER; i++){
+    if((fd = open(name(0, i), O_CREATE|O_TRUNC|O_WRONLY)) < 0)
+      fail("create");
+    memset(buf, 'a' + i, sizeof(buf));
+    for(j = 0; j < RBLOCKS; j++)
+      if(write(fd, buf, sizeof(buf)) != sizeof(buf))
+        fail("write");
+    close(fd);
+  }
+  diskctl(DISK_SCHED, IOSCHED_NOOP);
+  run("noop    ", ticks);
+  diskctl(DISK_SCHED, IOSCHED_DEADLINE);
+  run("deadline", ticks);
+  diskctl(DISK_SCHED, old);
+  for(i = 0; i < NREADER; i++)
+    unlink(name(0, i));
+  for(i = 0; i < NWRITER; i++)
+    unlink(name(1, i));
+  printf("iosbench: OK\n");
+  exit(0);
+}
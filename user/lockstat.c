@@ -0,0 +1,166 @@
+// Show kernel lock contention, most contended first.
+//
+// usage: lockstat [-a] [-n count] [command ...]
+//
+// With a command, the counters are reset, the command is run
+// and its contention is shown; without one, the totals since
+// boot. Locks with the same name, such as the 64 proc locks,
+// are added together unless -a is given. Times are in
+// microseconds. For sleep locks, spun and slept split the
+// contended acquires into those that got the lock while
+// spinning on a running holder and those that had to sleep.
+
+#include "kernel/types.h"
+#include "kernel/memlayout.h"
+#include "kernel/lockstat.h"
+#include "user/user.h"
+
+#define NLOCK 1024
+
+struct lockstat *st;
+int nlocks[NLOCK];   // locks folded into each entry
+char *kinds[] = {
+[LOCK_SPIN]   "spin ",
+[LOCK_SLEEP]  "sleep",
+[LOCK_RW]     "rw   ",
+};
+
+int
+cmp(struct lockstat *a, struct lockstat *b)
+{
+  if(a->ncontend != b->ncontend)
+    return a->ncontend > b->ncontend ? -1 : 1;
+  if(a->wait != b->wait)
+    return a->wait > b->wait ? -1 : 1;
+  return a->nacquire > b->nacquire ? -1 : a->nacquire < b->nacquire;
+}
+
+// add each lock into the first one with the same name
+// and kind. Returns the new count.
+int
+fold(int n)
+{
+  int i, j, m = 0;
+
+  for(i = 0; i < n; i++){
+    for(j = 0; j < m; j++)
+      if(st[j].kind == st[i].kind && strcmp(st[j].name, st[i].name) == 0)
+        break;
+    if(j == m){
+      st[m++] = st[i];
+      nlocks[j] = 1;
+      continue;
+    }
+    st[j].nacquire += st[i].nacquire;
+    st[j].ncontend += st[i].ncontend;
+    st[j].wait += st[i].wait;
+    st[j].nspin += st[i].nspin;
+    st[j].nsleep += st[i].nsleep;
+    if(st[i].maxhold > st[j].maxhold)
+      st[j].maxhold = st[i].maxhold;
+    nlocks[j]++;
+  }
+  return m;
+}
+
+void
+sort(int n)
+{
+  struct lockstat t;
+  int i, j, k;
+
+  for(i = 1; i < n; i++){
+    t = st[i];
+    k = nlocks[i];
+    for(j = i; j > 0 && cmp(&st[j-1], &t) > 0; j--){
+      st[j] = st[j-1];
+      nlocks[j] = nlocks[j-1];
+    }
+    st[j] = t;
+    nlocks[j] = k;
+  }
+}
+
+#define USEC(c) ((c) / (CLINT_FREQ / 1000000))
+
+// print n right-aligned in a field w characters wide.
+void
+col(uint64 n, int w)
+{
+  char buf[24];
+  int i = sizeof(buf);
+
+  buf[--i] = 0;
+  do {
+    buf[--i] = '0' + n % 10;
+    n /= 10;
+  } while(n != 0);
+  for(w -= sizeof(buf) - 1 - i; w > 0; w--)
+    printf(" ");
+  printf("%s", buf + i);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int all = 0, count = 20, n, i, pid;
+
+  for(; argc > 1 && argv[1][0] == '-'; argc--, argv++){
+    if(strcmp(argv[1], "-a") == 0){
+      all = 1;
+    } else if(strcmp(argv[1], "-n") == 0 && argc > 2){
+      count = atoi(argv[2]);
+      argc--, argv++;
+    } else {
+      fprintf(2, "Usage: lockstat [-a] [-n count] [command ...]\n");
+      exit(1);
+    }
+  }
+
+  if((st = malloc(NLOCK * sizeof(*st))) == 0){
+    fprintf(2, "lockstat: out of memory\n");
+    exit(1);
+  }
+
+  if(argc > 1){
+    lockstat(0, 0);
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "lockstat: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[1], argv+1);
+      fprintf(2, "lockstat: exec %s failed\n", argv[1]);
+      exit(1);
+    }
+    wait(0);
+  }
+
+  if((n = lockstat(st, NLOCK)) < 0){
+    fprintf(2, "lockstat: lockstat failed\n");
+    exit(1);
+  }
+  if(all){
+    for(i = 0; i < n; i++)
+      nlocks[i] = 1;
+  } else {
+    n = fold(n);
+  }
+  sort(n);
+
+  printf("contended   acquired  wait-total   wait-avg   max-hold   spun  slept kind  locks name\n");
+  for(i = 0; i < n && i < count; i++){
+    col(st[i].ncontend, 9);
+    col(st[i].nacquire, 11);
+    col(USEC(st[i].wait), 12);
+    col(st[i].ncontend ? USEC(st[i].wait / st[i].ncontend) : 0, 11);
+    col(USEC(st[i].maxhold), 11);
+    col(st[i].nspin, 7);
+    col(st[i].nsleep, 7);
+    printf(" %s", kinds[st[i].kind]);
+    col(nlocks[i], 6);
+    printf(" %s\n", st[i].name);
+  }
+  exit(0);
+}
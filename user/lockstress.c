@@ -0,0 +1,136 @@
+// Hammer hot kernel spinlocks from 1 up to 8 harts, one
+// process pinned to each, and report throughput and how
+// evenly the lock was shared.
+//
+// usage: lockstress [kmem|tick|bcache] [ticks]
+//
+// kmem grows and shrinks the heap by a page (kmem.lock),
+// tick calls uptime() (tickslock), and bcache stats the
+// root directory (the bcache locks). Run qemu with CPUS=8 to
+// see all 8 hart counts.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/stat.h"
+#include "kernel/sysinfo.h"
+#include "user/user.h"
+
+#define MAXHART 8
+
+// what each process reports, in a single write so that
+// reports don't interleave in the pipe.
+struct result {
+  uint64 hart;
+  uint64 count;
+};
+
+void
+op(char *which)
+{
+  struct stat st;
+
+  if(which[0] == 'k'){
+    sbrk(4096);
+    sbrk(-4096);
+  } else if(which[0] == 't'){
+    uptime();
+  } else {
+    stat("/", &st);
+  }
+}
+
+void
+run(char *which, int nhart, int ticks)
+{
+  int fds[2], i, pid, start;
+  uint64 n[MAXHART], total, min, max, sq;
+
+  if(pipe(fds) < 0){
+    fprintf(2, "lockstress: pipe failed\n");
+    exit(1);
+  }
+  // start everyone on the same tick.
+  start = uptime() + 2;
+  for(i = 0; i < nhart; i++){
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "lockstress: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      struct result r = { i, 0 };
+      if(sched_setaffinity(0, 1L << i) < 0){
+        fprintf(2, "lockstress: cannot pin to hart %d\n", i);
+        exit(1);
+      }
+      while(uuptime() < start)
+        ;
+      while(uuptime() < start + ticks){
+        op(which);
+        r.count++;
+      }
+      write(fds[1], &r, sizeof(r));
+      exit(0);
+    }
+  }
+  close(fds[1]);
+  for(i = 0; i < nhart; i++){
+    struct result r;
+    if(read(fds[0], &r, sizeof(r)) != sizeof(r) || r.hart >= nhart){
+      fprintf(2, "lockstress: lost a result\n");
+      exit(1);
+    }
+    n[r.hart] = r.count;
+  }
+  close(fds[0]);
+  for(i = 0; i < nhart; i++)
+    wait(0);
+
+  total = sq = max = 0;
+  min = n[0];
+  for(i = 0; i < nhart; i++){
+    total += n[i];
+    sq += n[i] * n[i];
+    if(n[i] < min)
+      min = n[i];
+    if(n[i] > max)
+      max = n[i];
+  }
+  // Jain's fairness index, (sum n)^2 / (harts * sum n^2),
+  // is 100% when every hart got the same share.
+  printf("%s %d harts: %d ops/tick, min %d max %d, fairness %d%%:",
+         which, nhart, (int)(total / ticks), (int)min, (int)max,
+         sq ? (int)(total * total * 100 / (nhart * sq)) : 100);
+  for(i = 0; i < nhart; i++)
+    printf(" %d", (int)n[i]);
+  printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct sysinfo info;
+  char *which[] = { "kmem", "tick", "bcache" };
+  int ticks = 10, nhart, i, w;
+
+  if(argc > 2)
+    ticks = atoi(argv[2]);
+  if(argc > 3 || ticks < 1 || (argc > 1 && strcmp(argv[1], "kmem") != 0 &&
+     strcmp(argv[1], "tick") != 0 && strcmp(argv[1], "bcache") != 0)){
+    fprintf(2, "Usage: lockstress [kmem|tick|bcache] [ticks]\n");
+    exit(1);
+  }
+  if(sysinfo(&info, sizeof(info)) < 0 || info.version < 1){
+    fprintf(2, "lockstress: sysinfo failed\n");
+    exit(1);
+  }
+  nhart = info.ncpu < MAXHART ? info.ncpu : MAXHART;
+
+  for(w = 0; w < sizeof(which)/sizeof(which[0]); w++){
+    if(argc > 1 && strcmp(argv[1], which[w]) != 0)
+      continue;
+    for(i = 1; i <= nhart; i++)
+      run(which[w], i, ticks);
+  }
+  exit(0);
+}
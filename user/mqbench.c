@@ -0,0 +1,171 @@
+// Read private files from a cold buffer cache on 1 up to 8
+// harts at once, one process pinned to each, a block at a time
+// and without read-ahead, so that every read waits for the
+// disk. Report the combined throughput. With a disk queue per
+// hart, harts don't meet in the driver, so this should grow
+// with harts instead of staying flat.
+//
+// usage: mqbench [blocks]
+//
+// Run qemu with CPUS=8 to go up to 8 harts; the Makefile gives
+// the disk a queue per hart.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/riscv.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/sysinfo.h"
+#include "user/user.h"
+
+#define MAXHART 8
+
+// what each process reports, in a single write so that
+// reports don't interleave in the pipe.
+struct result {
+  uint64 hart;
+  uint64 cycles;
+  uint64 bad;
+};
+
+void
+fail(char *why)
+{
+  printf("mqbench: FAIL %s\n", why);
+  exit(1);
+}
+
+char*
+name(int i)
+{
+  static char buf[8];
+
+  strcpy(buf, "mqb0");
+  buf[3] = '0' + i;
+  return buf;
+}
+
+void
+setup(int nhart, int nblocks)
+{
+  char buf[BSIZE];
+  int fd, i, j;
+
+  for(i = 0; i < nhart; i++){
+    if((fd = open(name(i), O_CREATE|O_TRUNC|O_WRONLY)) < 0)
+      fail("create");
+    memset(buf, 'a' + i, sizeof(buf));
+    for(j = 0; j < nblocks; j++)
+      if(write(fd, buf, sizeof(buf)) != sizeof(buf))
+        fail("write");
+    close(fd);
+  }
+}
+
+// push the buffer cache down to its minimum size.
+void
+dropcache(void)
+{
+  char *sz0 = sbrk(0);
+  int n;
+
+  for(n = 1024*1024; n >= PGSIZE; ){
+    if(sbrk(n) == (char*)-1)
+      n /= 2;
+  }
+  sbrk(-(sbrk(0) - sz0));
+}
+
+void
+run(int nhart, int nblocks)
+{
+  struct sysinfo before, after;
+  int fds[2], i, j, pid, start, fd;
+  uint64 cycles;
+  char buf[BSIZE];
+
+  // let the flusher write the files back, so their buffers
+  // can go.
+  sleep(DIRTYAGE + 2);
+  dropcache();
+  if(pipe(fds) < 0)
+    fail("pipe");
+  sysinfo(&before, sizeof(before));
+  // start everyone on the same tick.
+  start = uptime() + 2;
+  for(i = 0; i < nhart; i++){
+    pid = fork();
+    if(pid < 0)
+      fail("fork");
+    if(pid == 0){
+      struct result r = { i, 0, 0 };
+      uint64 t0;
+      if(sched_setaffinity(0, 1L << i) < 0)
+        fail("cannot pin");
+      if((fd = open(name(i), O_RDONLY|O_RANDOM)) < 0)
+        fail("open");
+      while(uuptime() < start)
+        ;
+      t0 = uclock();
+      while(read(fd, buf, sizeof(buf)) == sizeof(buf)){
+        for(j = 0; j < sizeof(buf); j++)
+          if(buf[j] != 'a' + i)
+            r.bad++;
+      }
+      r.cycles = uclock() - t0;
+      close(fd);
+      write(fds[1], &r, sizeof(r));
+      exit(0);
+    }
+  }
+  close(fds[1]);
+  cycles = 0;
+  for(i = 0; i < nhart; i++){
+    struct result r;
+    if(read(fds[0], &r, sizeof(r)) != sizeof(r) || r.hart >= nhart)
+      fail("lost a result");
+    if(r.bad)
+      fail("wrong data");
+    if(r.cycles > cycles)
+      cycles = r.cycles;
+  }
+  close(fds[0]);
+  for(i = 0; i < nhart; i++){
+    int status;
+    wait(&status);
+    if(status != 0)
+      fail("child failed");
+  }
+  sysinfo(&after, sizeof(after));
+
+  printf("%d harts: %d blocks/s, %d disk reads in %d requests\n",
+         nhart, cycles ? (int)((uint64)nhart * nblocks * ufreq() / cycles) : 0,
+         (int)(after.diskread - before.diskread),
+         (int)(after.diskreq - before.diskreq));
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct sysinfo info;
+  int nblocks = 64, nhart, i;
+
+  if(argc > 1)
+    nblocks = atoi(argv[1]);
+  if(argc > 2 || nblocks < 1 || nblocks > MAXFILE){
+    fprintf(2, "Usage: mqbench [blocks], at most %d\n", MAXFILE);
+    exit(1);
+  }
+  if(sysinfo(&info, sizeof(info)) < 0 || info.version < 4)
+    fail("kernel has no request counters");
+  nhart = info.ncpu < MAXHART ? info.ncpu : MAXHART;
+
+  printf("mqbench: start\n");
+  setup(nhart, nblocks);
+  for(i = 1; i <= nhart; i++)
+    run(i, nblocks);
+  for(i = 0; i < nhart; i++)
+    unlink(name(i));
+  printf("mqbench: OK\n");
+  exit(0);
+}
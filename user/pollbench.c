@@ -0,0 +1,68 @@
+// Time small synchronous writes, each a log commit that waits
+// for the disk several times, with the disk driver sleeping
+// until the completion interrupt and then with it polling the
+// used ring first, and report the average latency of each.
+//
+// usage: pollbench [writes] [usec]
+//
+// usec is how long a waiter polls before it sleeps; 100 by
+// default. The driver's setting is put back at the end.
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/diskctl.h"
+#include "user/user.h"
+
+char *path = "pollbench.tmp";
+
+void
+run(char *what, int nwrite)
+{
+  uint64 t0, t1, usec;
+  char c = 'p';
+  int fd, i;
+
+  if((fd = open(path, O_CREATE|O_TRUNC|O_WRONLY)) < 0){
+    fprintf(2, "pollbench: cannot create %s\n", path);
+    exit(1);
+  }
+  t0 = uclock();
+  for(i = 0; i < nwrite; i++){
+    if(write(fd, &c, 1) != 1){
+      fprintf(2, "pollbench: write failed\n");
+      exit(1);
+    }
+  }
+  t1 = uclock();
+  close(fd);
+
+  usec = (t1 - t0) * 1000000 / ufreq();
+  printf("%s: %d writes in %d ms, %d us per write\n",
+         what, nwrite, (int)(usec / 1000), (int)(usec / nwrite));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nwrite = 200, poll = 100, old;
+
+  if(argc > 1)
+    nwrite = atoi(argv[1]);
+  if(argc > 2)
+    poll = atoi(argv[2]);
+  if(argc > 3 || nwrite < 1 || poll < 1){
+    fprintf(2, "Usage: pollbench [writes] [usec]\n");
+    exit(1);
+  }
+  if((old = diskctl(DISK_POLL, 0)) < 0){
+    fprintf(2, "pollbench: kernel cannot poll the disk\n");
+    exit(1);
+  }
+
+  run("interrupt", nwrite);
+  diskctl(DISK_POLL, poll);
+  run("polled   ", nwrite);
+  diskctl(DISK_POLL, old);
+  unlink(path);
+  exit(0);
+}
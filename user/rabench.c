@@ -0,0 +1,123 @@
+// Read a file sequentially from a cold buffer cache, with and
+// without read-ahead, and report the throughput of each, and
+// how many disk requests the blocks took. Read-ahead queues
+// blocks together, so adjacent ones share a request. If the
+// disk has event indexes, read-ahead also runs with them off
+// ("no coalescing"), to compare the interrupts and notifies
+// it takes with the default.
+//
+// usage: rabench [blocks]
+//
+// The cache is emptied before each run by allocating memory
+// until kalloc() runs out, which makes the buffer cache give
+// its unused pages back.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/riscv.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "kernel/sysinfo.h"
+#include "kernel/diskctl.h"
+#include "user/user.h"
+
+char *path = "rabench.tmp";
+char buf[512];
+
+void
+setup(int nblocks)
+{
+  int fd, i;
+
+  if((fd = open(path, O_CREATE|O_TRUNC|O_WRONLY)) < 0){
+    fprintf(2, "rabench: cannot create %s\n", path);
+    exit(1);
+  }
+  for(i = 0; i < nblocks * (BSIZE / sizeof(buf)); i++){
+    memset(buf, i, sizeof(buf));
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "rabench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+}
+
+// push the buffer cache down to its minimum size.
+void
+dropcache(void)
+{
+  char *sz0 = sbrk(0);
+  int n;
+
+  for(n = 1024*1024; n >= PGSIZE; ){
+    if(sbrk(n) == (char*)-1)
+      n /= 2;
+  }
+  sbrk(-(sbrk(0) - sz0));
+}
+
+void
+run(char *what, int omode)
+{
+  struct sysinfo before, after;
+  uint64 t0, t1, usec;
+  int fd, n, total = 0;
+
+  dropcache();
+  if((fd = open(path, O_RDONLY|omode)) < 0){
+    fprintf(2, "rabench: cannot open %s\n", path);
+    exit(1);
+  }
+  sysinfo(&before, sizeof(before));
+  t0 = uclock();
+  while((n = read(fd, buf, sizeof(buf))) > 0){
+    if(buf[0] != (char)(total / sizeof(buf))){
+      fprintf(2, "rabench: wrong data at %d\n", total);
+      exit(1);
+    }
+    total += n;
+  }
+  t1 = uclock();
+  sysinfo(&after, sizeof(after));
+  close(fd);
+
+  usec = (t1 - t0) * 1000000 / ufreq();
+  printf("%s: %d KB in %d ms, %d KB/s, %d disk reads in %d requests, %d read ahead\n",
+         what, total / 1024, (int)(usec / 1000),
+         usec ? (int)((uint64)total * 1000000 / 1024 / usec) : 0,
+         (int)(after.diskread - before.diskread),
+         (int)(after.diskreq - before.diskreq),
+         (int)(after.readahead - before.readahead));
+  printf("%s: %d disk interrupts, %d notifies\n", what,
+         (int)(after.diskintr - before.diskintr),
+         (int)(after.disknotify - before.disknotify));
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct sysinfo info;
+  int nblocks = 200, old;
+
+  if(argc > 1)
+    nblocks = atoi(argv[1]);
+  if(argc > 2 || nblocks < 1 || nblocks > MAXFILE){
+    fprintf(2, "Usage: rabench [blocks], at most %d\n", MAXFILE);
+    exit(1);
+  }
+  if(sysinfo(&info, sizeof(info)) < 0 || info.version < 5){
+    fprintf(2, "rabench: kernel has no read-ahead or disk counters\n");
+    exit(1);
+  }
+
+  setup(nblocks);
+  run("no read-ahead", O_RANDOM);
+  if((old = diskctl(DISK_COALESCE, 0)) >= 0){
+    run("no coalescing", 0);
+    diskctl(DISK_COALESCE, old);
+  }
+  run("read-ahead   ", 0);
+  unlink(path);
+  exit(0);
+}
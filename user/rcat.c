@@ -0,0 +1,77 @@
+// cat through the system call ring. Each ring_submit() writes
+// out the blocks read last time and reads the next RBATCH,
+// so a file costs one trap per RBATCH blocks instead of two
+// per block.
+
+#include "kernel/types.h"
+#include "kernel/syscall.h"
+#include "kernel/ring.h"
+#include "user/user.h"
+
+#define RBATCH  8
+#define RBSIZE  512
+#define WRITE   RBATCH  // ringcqe.data of the first write
+
+char buf[2][RBATCH][RBSIZE];
+int len[2][RBATCH];
+
+void
+cat(int fd)
+{
+  struct ringcqe c;
+  int i, cur, nw, eof;
+
+  cur = nw = eof = 0;
+  while(!eof || nw > 0){
+    for(i = 0; i < nw; i++)
+      ring_prep(SYS_write, 1, (uint64)buf[!cur][i], len[!cur][i], WRITE+i,
+                i < nw-1 ? RING_LINK : 0);
+    for(i = 0; !eof && i < RBATCH; i++)
+      ring_prep(SYS_read, fd, (uint64)buf[cur][i], RBSIZE, i,
+                i < RBATCH-1 ? RING_LINK : 0);
+    if(ring_submit() <= 0){
+      fprintf(2, "rcat: ring error\n");
+      exit(1);
+    }
+    nw = 0;
+    while(ring_reap(&c)){
+      if(c.data >= WRITE){
+        if(c.res != len[!cur][c.data-WRITE]){
+          fprintf(2, "rcat: write error\n");
+          exit(1);
+        }
+      } else if(!(c.flags & RING_CANCELED)){
+        if(c.res < 0){
+          fprintf(2, "rcat: read error\n");
+          exit(1);
+        }
+        if(c.res == 0)
+          eof = 1;
+        else
+          len[cur][nw++] = c.res;
+      }
+    }
+    cur = !cur;
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd, i;
+
+  if(argc <= 1){
+    cat(0);
+    exit(0);
+  }
+
+  for(i = 1; i < argc; i++){
+    if((fd = open(argv[i], 0)) < 0){
+      fprintf(2, "rcat: cannot open %s\n", argv[i]);
+      exit(1);
+    }
+    cat(fd);
+    close(fd);
+  }
+  exit(0);
+}
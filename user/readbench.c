@@ -0,0 +1,169 @@
+// Read one file, or look up one path, from 1 up to 8 harts
+// at once, one process pinned to each, and report the
+// throughput. Readers share the inode lock, so this should
+// scale with the number of harts instead of staying flat.
+//
+// usage: readbench [read|lookup] [ticks]
+//
+// read reads a small, cached file through a private file
+// descriptor, reopening it at the end; lookup opens and
+// closes a path three directories deep. Run qemu with
+// CPUS=8 to see all 8 hart counts.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/sysinfo.h"
+#include "user/user.h"
+
+#define MAXHART 8
+#define FILESIZE 4096
+
+char *path = "rbdir/a/b/file";
+
+// what each process reports, in a single write so that
+// reports don't interleave in the pipe.
+struct result {
+  uint64 hart;
+  uint64 count;
+};
+
+void
+setup(void)
+{
+  char buf[512];
+  int fd, i;
+
+  mkdir("rbdir");
+  mkdir("rbdir/a");
+  mkdir("rbdir/a/b");
+  if((fd = open(path, O_CREATE|O_TRUNC|O_WRONLY)) < 0){
+    fprintf(2, "readbench: cannot create %s\n", path);
+    exit(1);
+  }
+  memset(buf, 'r', sizeof(buf));
+  for(i = 0; i < FILESIZE; i += sizeof(buf)){
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "readbench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+}
+
+void
+cleanup(void)
+{
+  unlink(path);
+  unlink("rbdir/a/b");
+  unlink("rbdir/a");
+  unlink("rbdir");
+}
+
+int
+reopen(int fd)
+{
+  if(fd >= 0)
+    close(fd);
+  if((fd = open(path, O_RDONLY)) < 0){
+    fprintf(2, "readbench: cannot open %s\n", path);
+    exit(1);
+  }
+  return fd;
+}
+
+void
+run(char *which, int nhart, int ticks)
+{
+  int fds[2], i, pid, start, fd;
+  uint64 total;
+  uint64 n[MAXHART];
+  char buf[512];
+
+  if(pipe(fds) < 0){
+    fprintf(2, "readbench: pipe failed\n");
+    exit(1);
+  }
+  // start everyone on the same tick.
+  start = uptime() + 2;
+  for(i = 0; i < nhart; i++){
+    pid = fork();
+    if(pid < 0){
+      fprintf(2, "readbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      struct result r = { i, 0 };
+      if(sched_setaffinity(0, 1L << i) < 0){
+        fprintf(2, "readbench: cannot pin to hart %d\n", i);
+        exit(1);
+      }
+      fd = reopen(-1);
+      while(uuptime() < start)
+        ;
+      while(uuptime() < start + ticks){
+        if(which[0] == 'r'){
+          if(read(fd, buf, sizeof(buf)) <= 0)
+            fd = reopen(fd);
+        } else {
+          close(reopen(-1));
+        }
+        r.count++;
+      }
+      write(fds[1], &r, sizeof(r));
+      exit(0);
+    }
+  }
+  close(fds[1]);
+  for(i = 0; i < nhart; i++){
+    struct result r;
+    if(read(fds[0], &r, sizeof(r)) != sizeof(r) || r.hart >= nhart){
+      fprintf(2, "readbench: lost a result\n");
+      exit(1);
+    }
+    n[r.hart] = r.count;
+  }
+  close(fds[0]);
+  for(i = 0; i < nhart; i++)
+    wait(0);
+
+  total = 0;
+  for(i = 0; i < nhart; i++)
+    total += n[i];
+  printf("%s %d harts: %d ops/tick:", which, nhart, (int)(total / ticks));
+  for(i = 0; i < nhart; i++)
+    printf(" %d", (int)n[i]);
+  printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct sysinfo info;
+  char *which[] = { "read", "lookup" };
+  int ticks = 10, nhart, i, w;
+
+  if(argc > 2)
+    ticks = atoi(argv[2]);
+  if(argc > 3 || ticks < 1 || (argc > 1 && strcmp(argv[1], "read") != 0 &&
+     strcmp(argv[1], "lookup") != 0)){
+    fprintf(2, "Usage: readbench [read|lookup] [ticks]\n");
+    exit(1);
+  }
+  if(sysinfo(&info, sizeof(info)) < 0 || info.version < 1){
+    fprintf(2, "readbench: sysinfo failed\n");
+    exit(1);
+  }
+  nhart = info.ncpu < MAXHART ? info.ncpu : MAXHART;
+
+  setup();
+  for(w = 0; w < sizeof(which)/sizeof(which[0]); w++){
+    if(argc > 1 && strcmp(argv[1], which[w]) != 0)
+      continue;
+    for(i = 1; i <= nhart; i++)
+      run(which[w], i, ticks);
+  }
+  cleanup();
+  exit(0);
+}
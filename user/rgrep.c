@@ -0,0 +1,3 @@
+// grep, reading ahead through the system call ring with rread().
+#define read rread
+#include "user/grep.c"
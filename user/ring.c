@@ -0,0 +1,126 @@
+// Helpers for the system call submission ring; see kernel/ring.c.
+//
+// Queue calls with ring_prep(), run them with ring_submit(),
+// and collect their results, in order, with ring_reap().
+// Like malloc(), these are not thread-safe. A child of fork()
+// gets a ring of its own the first time it queues a call.
+
+#include "kernel/types.h"
+#include "kernel/syscall.h"
+#include "kernel/ring.h"
+#include "user/user.h"
+
+struct ring *ring;
+static int ringpid;   // ugetpid() when ring was set up
+
+// The caller's ring, or 0 if it has none yet. fork() doesn't
+// copy the kernel's mapping, so a ring inherited from the
+// parent is forgotten. ugetpid() tells them apart: a child
+// has its own, and threads share their creator's.
+static struct ring*
+myring(void)
+{
+  if(ring && ringpid != ugetpid())
+    ring = 0;
+  return ring;
+}
+
+// Queue system call num. Returns -1 if the queue is full
+// or the ring can't be set up.
+int
+ring_prep(int num, uint64 a0, uint64 a1, uint64 a2, uint64 data, int flags)
+{
+  struct ringsqe *sqe;
+
+  if(myring() == 0){
+    if((long)(ring = ring_setup()) == -1){
+      ring = 0;
+      return -1;
+    }
+    ringpid = ugetpid();
+  }
+  if(ring->sqtail - ring->sqhead >= NRING)
+    return -1;
+  sqe = &ring->sq[ring->sqtail % NRING];
+  sqe->num = num;
+  sqe->flags = flags;
+  sqe->arg[0] = a0;
+  sqe->arg[1] = a1;
+  sqe->arg[2] = a2;
+  sqe->data = data;
+  __sync_synchronize();
+  ring->sqtail++;
+  return 0;
+}
+
+// Run everything queued. Returns the number of calls run.
+int
+ring_submit(void)
+{
+  if(myring() == 0)
+    return 0;
+  return ring_enter(ring->sqtail - ring->sqhead);
+}
+
+// Copy the oldest completion to *c. Returns 0 if there is none.
+int
+ring_reap(struct ringcqe *c)
+{
+  if(myring() == 0 || ring->cqhead == ring->cqtail)
+    return 0;
+  __sync_synchronize();
+  *c = ring->cq[ring->cqhead % NRING];
+  ring->cqhead++;
+  return 1;
+}
+
+#define RBATCH  8     // reads per ring_submit()
+#define RBSIZE  512   // bytes per read
+
+static struct {
+  char *buf;          // RBATCH*RBSIZE bytes
+  int fd;
+  int off;
+  int len;
+} rb;
+
+// Like read(), but reads ahead RBATCH blocks at a time with
+// a single trap. Read one file at a time: anything read
+// ahead from fd is lost if rread() is then used on another
+// file before this one returns 0.
+int
+rread(int fd, void *dst, int n)
+{
+  struct ringcqe c;
+  int i, err;
+
+  if(rb.buf == 0 && (rb.buf = malloc(RBATCH*RBSIZE)) == 0)
+    return -1;
+  if(rb.fd != fd || rb.off == rb.len){
+    rb.fd = fd;
+    rb.off = rb.len = 0;
+    // a short read cancels the rest, so the data that
+    // was read is contiguous.
+    for(i = 0; i < RBATCH; i++)
+      if(ring_prep(SYS_read, fd, (uint64)(rb.buf + i*RBSIZE), RBSIZE, i,
+                   i < RBATCH-1 ? RING_LINK : 0) < 0)
+        return -1;
+    ring_submit();
+    err = 0;
+    while(ring_reap(&c)){
+      if(c.flags & RING_CANCELED)
+        continue;
+      if(c.res < 0)
+        err = 1;
+      else
+        rb.len += c.res;
+    }
+    if(err && rb.len == 0)
+      return -1;
+  }
+  if(n > rb.len - rb.off)
+    n = rb.len - rb.off;
+  memmove(dst, rb.buf + rb.off, n);
+  rb.off += n;
+  return n;
+}
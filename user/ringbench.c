@@ -0,0 +1,109 @@
+// Compare system calls made through the submission ring with
+// plain ones: getpid() and reading a file in 512-byte blocks.
+// Times are CPU time, from getrusage().
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/memlayout.h"
+#include "kernel/syscall.h"
+#include "kernel/rusage.h"
+#include "kernel/ring.h"
+#include "user/user.h"
+
+#define NCALL   20000
+#define FILESZ  (64*1024)
+#define NREAD   20
+
+char buf[512];
+
+uint64
+now()
+{
+  struct rusage ru;
+
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.utime + ru.stime;
+}
+
+void
+report(char *what, int n, uint64 plain, uint64 ringed)
+{
+  printf("%s: %d calls, plain %d ns/call, ring %d ns/call\n", what, n,
+         (int)(plain * (1000000000 / CLINT_FREQ) / n),
+         (int)(ringed * (1000000000 / CLINT_FREQ) / n));
+}
+
+void
+benchgetpid()
+{
+  struct ringcqe c;
+  uint64 t0, t1, t2;
+  int i, j;
+
+  t0 = now();
+  for(i = 0; i < NCALL; i++)
+    getpid();
+  t1 = now();
+  for(i = 0; i < NCALL; i += NRING){
+    for(j = 0; j < NRING; j++)
+      ring_prep(SYS_getpid, 0, 0, 0, 0, 0);
+    ring_submit();
+    while(ring_reap(&c))
+      ;
+  }
+  t2 = now();
+  report("getpid", NCALL, t1 - t0, t2 - t1);
+}
+
+int
+readall(int (*rd)(int, void*, int))
+{
+  int fd, n, total = 0;
+
+  if((fd = open("ringbench.tmp", O_RDONLY)) < 0){
+    fprintf(2, "ringbench: open failed\n");
+    exit(1);
+  }
+  while((n = rd(fd, buf, sizeof(buf))) > 0)
+    total += n;
+  close(fd);
+  if(total != FILESZ){
+    fprintf(2, "ringbench: read %d bytes, not %d\n", total, FILESZ);
+    exit(1);
+  }
+  return FILESZ / sizeof(buf);
+}
+
+void
+benchread()
+{
+  uint64 t0, t1, t2;
+  int fd, i, n = 0;
+
+  if((fd = open("ringbench.tmp", O_CREATE|O_WRONLY)) < 0){
+    fprintf(2, "ringbench: create failed\n");
+    exit(1);
+  }
+  memset(buf, 'x', sizeof(buf));
+  for(i = 0; i < FILESZ / sizeof(buf); i++)
+    write(fd, buf, sizeof(buf));
+  close(fd);
+
+  t0 = now();
+  for(i = 0; i < NREAD; i++)
+    n += readall(read);
+  t1 = now();
+  for(i = 0; i < NREAD; i++)
+    readall(rread);
+  t2 = now();
+  unlink("ringbench.tmp");
+  report("read", n, t1 - t0, t2 - t1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  benchgetpid();
+  benchread();
+  exit(0);
+}
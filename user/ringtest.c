@@ -0,0 +1,139 @@
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/syscall.h"
+#include "kernel/ring.h"
+#include "user/user.h"
+
+void
+fail(char *why)
+{
+  printf("ringtest: FAIL %s\n", why);
+  exit(1);
+}
+
+//
+// many calls, one trap, completed in order.
+//
+void
+testbatch()
+{
+  struct ringcqe c;
+  int i, pid = getpid();
+
+  for(i = 0; i < 10; i++)
+    if(ring_prep(SYS_getpid, 0, 0, 0, i, 0) < 0)
+      fail("ring_prep");
+  if(ring_submit() != 10)
+    fail("ring_submit");
+  for(i = 0; i < 10; i++){
+    if(!ring_reap(&c))
+      fail("missing completion");
+    if(c.data != i || c.res != pid || c.flags != 0)
+      fail("wrong completion");
+  }
+  if(ring_reap(&c))
+    fail("extra completion");
+
+  // calls that would change the address space are refused.
+  ring_prep(SYS_sbrk, 4096, 0, 0, 0, 0);
+  ring_submit();
+  if(!ring_reap(&c) || c.res != -1)
+    fail("sbrk ran in the ring");
+}
+
+//
+// a failed call cancels the rest of its chain, and only that.
+//
+void
+testlink()
+{
+  struct ringcqe c;
+
+  ring_prep(SYS_read, -1, 0, 0, 0, RING_LINK);
+  ring_prep(SYS_getpid, 0, 0, 0, 1, RING_LINK);
+  ring_prep(SYS_getpid, 0, 0, 0, 2, 0);
+  ring_prep(SYS_getpid, 0, 0, 0, 3, 0);
+  if(ring_submit() != 4)
+    fail("ring_submit");
+  if(!ring_reap(&c) || c.res != -1 || c.flags != 0)
+    fail("bad read succeeded");
+  if(!ring_reap(&c) || !(c.flags & RING_CANCELED) ||
+     !ring_reap(&c) || !(c.flags & RING_CANCELED))
+    fail("chain not canceled");
+  if(!ring_reap(&c) || c.data != 3 || c.res != getpid())
+    fail("cancel leaked past the chain");
+}
+
+//
+// file i/o through the ring, and rread().
+//
+void
+testfile()
+{
+  static char data[5000], got[5000];
+  struct ringcqe c;
+  int fd, i, n;
+
+  for(i = 0; i < sizeof(data); i++)
+    data[i] = 'a' + i % 23;
+  ring_prep(SYS_open, (uint64)"ringtest.tmp", O_CREATE|O_WRONLY, 0, 0, 0);
+  ring_submit();
+  if(!ring_reap(&c) || (fd = c.res) < 0)
+    fail("open");
+  ring_prep(SYS_write, fd, (uint64)data, 3000, 0, RING_LINK);
+  ring_prep(SYS_write, fd, (uint64)data+3000, sizeof(data)-3000, 1, RING_LINK);
+  ring_prep(SYS_close, fd, 0, 0, 2, 0);
+  ring_submit();
+  for(i = 0; i < 3; i++)
+    if(!ring_reap(&c) || c.res < 0)
+      fail("write");
+
+  if((fd = open("ringtest.tmp", O_RDONLY)) < 0)
+    fail("reopen");
+  for(i = 0; (n = rread(fd, got+i, 700)) > 0; i += n)
+    ;
+  close(fd);
+  unlink("ringtest.tmp");
+  if(n < 0 || i != sizeof(data) || memcmp(data, got, sizeof(data)) != 0)
+    fail("rread data");
+}
+
+//
+// fork() does not copy the ring, but the library sets up a
+// new one for the child when it queues a call.
+//
+void
+testfork()
+{
+  struct ringcqe c;
+  int pid, status;
+
+  pid = fork();
+  if(pid < 0)
+    fail("fork");
+  if(pid == 0){
+    if(ring_enter(1) != -1)
+      exit(1);
+    if(ring_prep(SYS_getpid, 0, 0, 0, 0, 0) < 0 || ring_submit() != 1 ||
+       !ring_reap(&c) || c.res != getpid())
+      exit(2);
+    exit(0);
+  }
+  wait(&status);
+  if(status == 1)
+    fail("child has a ring");
+  if(status != 0)
+    fail("child cannot use a ring");
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf("ringtest: start\n");
+  testbatch();
+  testlink();
+  testfile();
+  testfork();
+  printf("ringtest: OK\n");
+  exit(0);
+}
@@ -0,0 +1,77 @@
+#include "kernel/types.h"
+#include "kernel/schedstat.h"
+#include "user/user.h"
+
+//
+// parameters are checked, and admission control refuses
+// to reserve more than RTUTIL percent of a hart.
+//
+void
+testadmit()
+{
+  int pid, status;
+
+  if(sched_setrt(0, 5, 4, 4) != -1 || sched_setrt(0, 2, 4, 8) != -1){
+    printf("rttest: FAIL accepted inconsistent parameters\n");
+    exit(1);
+  }
+  if(sched_setrt(0, 5, 10, 10) < 0){
+    printf("rttest: FAIL sched_setrt refused 50%%\n");
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("rttest: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    // the parent already holds half a hart.
+    if(sched_setrt(0, 5, 10, 10) != -1)
+      exit(1);
+    if(sched_setrt(0, 2, 10, 10) < 0)
+      exit(2);
+    exit(0);
+  }
+  wait(&status);
+  if(status != 0){
+    printf("rttest: FAIL admission control in child (%d)\n", status);
+    exit(1);
+  }
+  // the exited child's reservation was returned.
+  if(sched_setrt(0, 0, 0, 0) < 0 || sched_setrt(0, 9, 10, 10) < 0 ||
+     sched_setrt(0, 0, 0, 0) < 0){
+    printf("rttest: FAIL reservation was not released\n");
+    exit(1);
+  }
+}
+
+//
+// a process that runs past its budget is throttled.
+//
+void
+testbudget()
+{
+  struct schedstat st;
+
+  if(sched_setrt(0, 1, 3, 3) < 0){
+    printf("rttest: FAIL sched_setrt failed\n");
+    exit(1);
+  }
+  for(volatile int i = 0; i < 50000000; i++)
+    ;
+  if(schedstat(0, &st) < 0 || st.rtthrottled == 0){
+    printf("rttest: FAIL budget was never enforced\n");
+    exit(1);
+  }
+  sched_setrt(0, 0, 0, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf("rttest: start\n");
+  testadmit();
+  testbudget();
+  printf("rttest: OK\n");
+  exit(0);
+}
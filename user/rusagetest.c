@@ -0,0 +1,88 @@
+#include "kernel/types.h"
+#include "kernel/rusage.h"
+#include "user/user.h"
+
+void
+spin()
+{
+  for(volatile int i = 0; i < 20000000; i++)
+    ;
+}
+
+//
+// user time and voluntary context switches of the caller.
+//
+void
+testself()
+{
+  struct rusage ru0, ru1;
+
+  if(getrusage(RUSAGE_SELF, &ru0) < 0){
+    printf("rusagetest: FAIL getrusage failed\n");
+    exit(1);
+  }
+  spin();
+  sleep(1);
+  getrusage(RUSAGE_SELF, &ru1);
+  if(ru1.utime <= ru0.utime){
+    printf("rusagetest: FAIL utime did not grow\n");
+    exit(1);
+  }
+  if(ru1.stime < ru0.stime){
+    printf("rusagetest: FAIL stime went backwards\n");
+    exit(1);
+  }
+  if(ru1.nvcsw <= ru0.nvcsw){
+    printf("rusagetest: FAIL sleep was not a voluntary switch\n");
+    exit(1);
+  }
+  if(getrusage(2, &ru1) != -1){
+    printf("rusagetest: FAIL getrusage accepted a bad who\n");
+    exit(1);
+  }
+}
+
+//
+// wait3() reports a child's usage, which is then
+// added to RUSAGE_CHILDREN.
+//
+void
+testchild()
+{
+  struct rusage ru, cru0, cru1;
+  int pid, status;
+
+  getrusage(RUSAGE_CHILDREN, &cru0);
+  pid = fork();
+  if(pid < 0){
+    printf("rusagetest: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    spin();
+    exit(7);
+  }
+  if(wait3(&status, &ru) != pid || status != 7){
+    printf("rusagetest: FAIL wait3\n");
+    exit(1);
+  }
+  if(ru.utime == 0){
+    printf("rusagetest: FAIL child utime is 0\n");
+    exit(1);
+  }
+  getrusage(RUSAGE_CHILDREN, &cru1);
+  if(cru1.utime - cru0.utime != ru.utime){
+    printf("rusagetest: FAIL child usage not accumulated\n");
+    exit(1);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf("rusagetest: start\n");
+  testself();
+  testchild();
+  printf("rusagetest: OK\n");
+  exit(0);
+}
@@ -0,0 +1,3 @@
+// wc, reading ahead through the system call ring with rread().
+#define read rread
+#include "user/wc.c"
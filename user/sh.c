@@ -3,6 +3,8 @@
 #include "kernel/types.h"
 #include "user/user.h"
 #include "kernel/fcntl.h"
+#include "kernel/memlayout.h"
+#include "kernel/rusage.h"
 
 // Parsed command representation
 #define EXEC  1
@@ -52,6 +54,7 @@ struct backcmd {
 int fork1(void);  // Fork but panics on failure.
 void panic(char*);
 struct cmd *parsecmd(char*);
+void runtime(char*);
 
 // Execute cmd.  Never returns.
 void
@@ -164,6 +167,10 @@ main(void)
         fprintf(2, "cannot cd %s\n", buf+3);
       continue;
     }
+    if(memcmp(buf, "time ", 5) == 0){
+      runtime(buf+5);
+      continue;
+    }
     if(fork1() == 0)
       runcmd(parsecmd(buf));
     wait(0);
@@ -171,6 +178,33 @@ main(void)
   exit(0);
 }
 
+// print ms milliseconds as seconds.
+void
+printsecs(char *label, uint64 ms)
+{
+  fprintf(2, "%s %d.%d%d%ds", label, (int)(ms/1000),
+          (int)(ms/100%10), (int)(ms/10%10), (int)(ms%10));
+}
+
+// Run cmd, then report its elapsed, user and system time.
+void
+runtime(char *cmd)
+{
+  struct rusage ru;
+  int t0;
+
+  t0 = uptime();
+  if(fork1() == 0)
+    runcmd(parsecmd(cmd));
+  if(wait3(0, &ru) < 0)
+    return;
+  // a clock tick is about 1/10th second in qemu.
+  printsecs("real", (uptime() - t0) * 100);
+  printsecs(" user", ru.utime / (CLINT_FREQ/1000));
+  printsecs(" sys", ru.stime / (CLINT_FREQ/1000));
+  fprintf(2, "\n");
+}
+
 void
 panic(char *s)
 {
@@ -0,0 +1,168 @@
+// Count a command's system calls and their latency, like
+// strace -c. With -s, count every process's calls instead of
+// only the command's and its children's; with no command,
+// report everything since boot. -h adds log2 histograms.
+
+#include "kernel/types.h"
+#include "kernel/memlayout.h"
+#include "kernel/syscall.h"
+#include "kernel/syscallnames.h"
+#include "kernel/scstat.h"
+#include "user/user.h"
+
+struct scstat before[NSCSTAT];
+struct scstat st[NSCSTAT];
+
+// print the decimal number n, with frac digits after the
+// point, right-aligned in a field w characters wide.
+void
+num(uint64 n, int frac, int w)
+{
+  char buf[32];
+  int i = sizeof(buf);
+
+  buf[--i] = 0;
+  do {
+    buf[--i] = '0' + n % 10;
+    n /= 10;
+    if(--frac == 0)
+      buf[--i] = '.';
+  } while(n != 0 || frac >= 0);
+  for(w -= sizeof(buf) - 1 - i; w > 0; w--)
+    printf(" ");
+  printf("%s", buf + i);
+}
+
+void
+hist(struct scstat *s)
+{
+  uint max = 0;
+
+  for(int b = 0; b < NLATBUCKET; b++)
+    if(s->hist[b] > max)
+      max = s->hist[b];
+  for(int b = 0; b < NLATBUCKET; b++){
+    if(s->hist[b] == 0)
+      continue;
+    // cycles are tenths of a microsecond.
+    printf("    ");
+    num((1L << b), 1, 10);
+    printf(b == NLATBUCKET-1 ? " us -          " : " us - ");
+    if(b < NLATBUCKET-1)
+      num((2L << b), 1, 9);
+    printf(b == NLATBUCKET-1 ? " " : " us ");
+    num(s->hist[b], 0, 8);
+    printf(" |");
+    for(int i = 0; i < s->hist[b] * 40 / max; i++)
+      printf("@");
+    printf("\n");
+  }
+}
+
+void
+report(int histograms)
+{
+  uint64 total = 0, calls = 0, errors = 0;
+  int order[NSCSTAT], n = 0;
+
+  for(int i = 0; i < NSCSTAT; i++){
+    if(st[i].count == 0)
+      continue;
+    total += st[i].cycles;
+    calls += st[i].count;
+    errors += st[i].errors;
+    // insertion sort, most time first.
+    int j;
+    for(j = n++; j > 0 && st[order[j-1]].cycles < st[i].cycles; j--)
+      order[j] = order[j-1];
+    order[j] = i;
+  }
+
+  printf("%% time     seconds  usecs/call     calls    errors syscall\n");
+  printf("------ ----------- ----------- --------- --------- ----------------\n");
+  for(int k = 0; k < n; k++){
+    struct scstat *s = &st[order[k]];
+    num(total ? s->cycles * 10000 / total : 0, 2, 6);
+    num(s->cycles / (CLINT_FREQ / 1000000), 6, 12);
+    num(s->cycles / (CLINT_FREQ / 1000000) / s->count, 0, 12);
+    num(s->count, 0, 10);
+    if(s->errors)
+      num(s->errors, 0, 10);
+    else
+      printf("          ");
+    printf(" %s\n", order[k] < sizeof(syscallnames)/sizeof(syscallnames[0]) && syscallnames[order[k]] ?
+           syscallnames[order[k]] : "?");
+    if(histograms)
+      hist(s);
+  }
+  printf("------ ----------- ----------- --------- --------- ----------------\n");
+  num(10000, 2, 6);
+  num(total / (CLINT_FREQ / 1000000), 6, 12);
+  num(calls ? total / (CLINT_FREQ / 1000000) / calls : 0, 0, 12);
+  num(calls, 0, 10);
+  num(errors, 0, 10);
+  printf(" total\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int system = 0, histograms = 0, pid;
+
+  while(argc > 1 && argv[1][0] == '-'){
+    if(strcmp(argv[1], "-s") == 0)
+      system = 1;
+    else if(strcmp(argv[1], "-h") == 0)
+      histograms = 1;
+    else {
+      fprintf(2, "Usage: syscount [-s] [-h] [command]\n");
+      exit(1);
+    }
+    argc--;
+    argv++;
+  }
+
+  if(argc < 2){
+    if(scstat(SCSTAT_SYSTEM, st) < 0){
+      fprintf(2, "syscount: scstat failed\n");
+      exit(1);
+    }
+    report(histograms);
+    exit(0);
+  }
+
+  if(system)
+    scstat(SCSTAT_SYSTEM, before);
+  else if(scprofile(1) < 0){
+    fprintf(2, "syscount: scprofile failed\n");
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "syscount: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv+1);
+    fprintf(2, "syscount: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+
+  if(system){
+    scstat(SCSTAT_SYSTEM, st);
+    for(int i = 0; i < NSCSTAT; i++){
+      st[i].count -= before[i].count;
+      st[i].errors -= before[i].errors;
+      st[i].cycles -= before[i].cycles;
+      for(int b = 0; b < NLATBUCKET; b++)
+        st[i].hist[b] -= before[i].hist[b];
+    }
+  } else if(scstat(SCSTAT_CHILDREN, st) < 0){
+    fprintf(2, "syscount: scstat failed\n");
+    exit(1);
+  }
+  report(histograms);
+  exit(0);
+}
@@ -1,12 +1,15 @@
 #include "kernel/types.h"
+#include "kernel/param.h"
 #include "kernel/riscv.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
 #include "kernel/sysinfo.h"
 #include "user/user.h"
 
 
 void
 sinfo(struct sysinfo *info) {
-  if (sysinfo(info) < 0) {
+  if (sysinfo(info, sizeof(*info)) < 0) {
     printf("FAIL: sysinfo failed");
     exit(1);
   }
@@ -79,15 +82,28 @@ void
 testcall() {
   struct sysinfo info;
   
-  if (sysinfo(&info) < 0) {
+  if (sysinfo(&info, sizeof(info)) < 0) {
     printf("FAIL: sysinfo failed\n");
     exit(1);
   }
 
-  if (sysinfo((struct sysinfo *) 0xeaeb0b5b00002f5e) !=  0xffffffffffffffff) {
+  if (sysinfo((struct sysinfo *) 0xeaeb0b5b00002f5e, sizeof(info)) !=  0xffffffffffffffff) {
     printf("FAIL: sysinfo succeeded with bad argument\n");
     exit(1);
   }
+
+  if (info.version != SYSINFO_VERSION) {
+    printf("FAIL: sysinfo version %d instead of %d\n", info.version, SYSINFO_VERSION);
+    exit(1);
+  }
+
+  // a caller built against the original struct gets only
+  // freemem and nproc.
+  info.version = 0x5a5a;
+  if (sysinfo(&info, 2*sizeof(uint64)) < 0 || info.version != 0x5a5a) {
+    printf("FAIL: sysinfo wrote past the size it was given\n");
+    exit(1);
+  }
 }
 
 void testproc() {
@@ -120,6 +136,131 @@ void testproc() {
   }
 }
 
+//
+// hart busy time, and the load average, go up while
+// processes spin.
+//
+void testload() {
+  struct sysinfo before, after;
+  uint64 busy0 = 0, busy1 = 0;
+  int i, pid;
+
+  sinfo(&before);
+  if (before.ncpu < 1 || before.ncpu > NCPU) {
+    printf("sysinfotest: FAIL ncpu is %d\n", before.ncpu);
+    exit(1);
+  }
+  for (i = 0; i < 2; i++) {
+    pid = fork();
+    if (pid < 0) {
+      printf("sysinfotest: fork failed\n");
+      exit(1);
+    }
+    if (pid == 0) {
+      int t0 = uptime();
+      while (uptime() < t0 + 20)
+        ;
+      exit(0);
+    }
+  }
+  wait(0);
+  wait(0);
+  sinfo(&after);
+
+  for (i = 0; i < after.ncpu; i++) {
+    busy0 += before.cpu[i].busy;
+    busy1 += after.cpu[i].busy;
+  }
+  if (busy1 < busy0 + 20) {
+    printf("sysinfotest: FAIL busy ticks went from %d to %d\n", busy0, busy1);
+    exit(1);
+  }
+  if (after.ticks < before.ticks + 20 || after.loadavg[0] < LOAD_SCALE / 2) {
+    printf("sysinfotest: FAIL 1 second load average is %d/%d\n",
+           after.loadavg[0], LOAD_SCALE);
+    exit(1);
+  }
+}
+
+//
+// pipe, buffer cache, log and disk counters.
+//
+void testcounters() {
+  struct sysinfo before, after;
+  char buf[100];
+  int fds[2], fd;
+
+  sinfo(&before);
+  if (pipe(fds) < 0) {
+    printf("sysinfotest: pipe failed\n");
+    exit(1);
+  }
+  write(fds[1], buf, sizeof(buf));
+  read(fds[0], buf, sizeof(buf));
+  close(fds[0]);
+  close(fds[1]);
+  if ((fd = open("sysinfotest.tmp", O_CREATE|O_WRONLY)) < 0) {
+    printf("sysinfotest: open failed\n");
+    exit(1);
+  }
+  write(fd, buf, sizeof(buf));
+  close(fd);
+  unlink("sysinfotest.tmp");
+  sinfo(&after);
+
+  if (after.pipewrite < before.pipewrite + sizeof(buf) ||
+      after.piperead < before.piperead + sizeof(buf)) {
+    printf("sysinfotest: FAIL pipe bytes not counted\n");
+    exit(1);
+  }
+  if (after.bhit + after.bmiss <= before.bhit + before.bmiss) {
+    printf("sysinfotest: FAIL buffer cache lookups not counted\n");
+    exit(1);
+  }
+  if (after.logcommit <= before.logcommit || after.diskwrite <= before.diskwrite) {
+    printf("sysinfotest: FAIL log commits or disk writes not counted\n");
+    exit(1);
+  }
+}
+
+//
+// the buffer cache grows past NBUF for a large file, and
+// gives its buffers back when memory runs out.
+//
+void testbcache() {
+  struct sysinfo before, grown, after;
+  char buf[BSIZE];
+  int fd, i, n = 4*NBUF;
+
+  sinfo(&before);
+  if ((fd = open("sysinfotest.tmp", O_CREATE|O_WRONLY)) < 0) {
+    printf("sysinfotest: open failed\n");
+    exit(1);
+  }
+  for (i = 0; i < n; i++) {
+    if (write(fd, buf, sizeof(buf)) != sizeof(buf)) {
+      printf("sysinfotest: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+  sinfo(&grown);
+  if (grown.nbuf < NBUF || (grown.nbuf <= before.nbuf && before.nbuf < n)) {
+    printf("sysinfotest: FAIL buffer cache has %d buffers, had %d\n",
+           grown.nbuf, before.nbuf);
+    exit(1);
+  }
+
+  countfree();
+  sinfo(&after);
+  if (after.nbuf >= grown.nbuf && grown.nbuf > NBUF + 8) {
+    printf("sysinfotest: FAIL buffer cache kept %d buffers when memory ran out\n",
+           after.nbuf);
+    exit(1);
+  }
+  unlink("sysinfotest.tmp");
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -127,6 +268,9 @@ main(int argc, char *argv[])
   testcall();
   testmem();
   testproc();
+  testload();
+  testcounters();
+  testbcache();
   printf("sysinfotest: OK\n");
   exit(0);
 }
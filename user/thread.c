@@ -0,0 +1,86 @@
+// Threads on top of clone() and join().
+//
+// Each thread runs on a PGSIZE stack from malloc(). malloc()
+// is not thread-safe, so create and join threads from a
+// single thread.
+
+#include "kernel/types.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+// kept at the bottom of a new thread's stack.
+struct tstart {
+  void (*fn)(void*);
+  void *arg;
+};
+
+static void
+thread_start(void *a)
+{
+  struct tstart *ts = a;
+
+  ts->fn(ts->arg);
+  exit(0);
+}
+
+// Start fn(arg) in a new thread.
+// Returns the thread's pid, or -1 on failure.
+int
+thread_create(void (*fn)(void*), void *arg)
+{
+  struct tstart *ts;
+  int tid;
+
+  if((ts = malloc(PGSIZE)) == 0)
+    return -1;
+  ts->fn = fn;
+  ts->arg = arg;
+  if((tid = clone(thread_start, ts, ts)) < 0)
+    free(ts);
+  return tid;
+}
+
+// Wait for thread tid to exit, and free its stack.
+int
+thread_join(int tid)
+{
+  void *stack;
+
+  if((tid = join(tid, &stack)) < 0)
+    return -1;
+  free(stack);
+  return tid;
+}
+
+void
+tlock_init(struct tlock *lk)
+{
+  lk->locked = 0;
+}
+
+// An uncontended acquire or release is a single atomic
+// instruction; only a thread that finds the lock held
+// traps, to sleep in futex_wait().
+void
+tlock_acquire(struct tlock *lk)
+{
+  uint c;
+
+  if((c = __sync_val_compare_and_swap(&lk->locked, 0, 1)) == 0)
+    return;
+  do {
+    // tell the holder there are waiters, then sleep.
+    if(c == 2 || __sync_val_compare_and_swap(&lk->locked, 1, 2) != 0)
+      futex_wait(&lk->locked, 2);
+  } while((c = __sync_val_compare_and_swap(&lk->locked, 0, 2)) != 0);
+}
+
+void
+tlock_release(struct tlock *lk)
+{
+  if(__sync_fetch_and_sub(&lk->locked, 1) != 1){
+    lk->locked = 0;
+    __sync_synchronize();
+    futex_wake(&lk->locked, 1);
+  }
+}
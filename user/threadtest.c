@@ -0,0 +1,245 @@
+#include "kernel/types.h"
+#include "kernel/riscv.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define NTHR   4
+#define NITER  10000
+
+struct tlock lock;
+volatile int counter;
+char * volatile grown;
+
+void
+incr(void *arg)
+{
+  for(int i = 0; i < NITER; i++){
+    tlock_acquire(&lock);
+    counter++;
+    tlock_release(&lock);
+  }
+}
+
+//
+// threads increment a shared counter under a tlock.
+//
+void
+testcounter()
+{
+  int tids[NTHR];
+
+  tlock_init(&lock);
+  counter = 0;
+  for(int i = 0; i < NTHR; i++){
+    if((tids[i] = thread_create(incr, 0)) < 0){
+      printf("threadtest: FAIL thread_create\n");
+      exit(1);
+    }
+  }
+  for(int i = 0; i < NTHR; i++){
+    if(thread_join(tids[i]) != tids[i]){
+      printf("threadtest: FAIL thread_join\n");
+      exit(1);
+    }
+  }
+  if(counter != NTHR*NITER){
+    printf("threadtest: FAIL counter is %d instead of %d\n", counter, NTHR*NITER);
+    exit(1);
+  }
+}
+
+void
+grow(void *arg)
+{
+  char *p = sbrk(PGSIZE);
+
+  if(p == (char*)-1)
+    exit(1);
+  p[0] = 'x';
+  grown = p;
+}
+
+//
+// memory a thread adds with sbrk() is visible to its parent.
+//
+void
+testsbrk()
+{
+  int tid;
+
+  grown = 0;
+  if((tid = thread_create(grow, 0)) < 0){
+    printf("threadtest: FAIL thread_create\n");
+    exit(1);
+  }
+  thread_join(tid);
+  if(grown == 0 || grown[0] != 'x'){
+    printf("threadtest: FAIL sbrk in thread not shared\n");
+    exit(1);
+  }
+}
+
+void
+spin(void *arg)
+{
+  while(counter == 0)
+    ;
+}
+
+//
+// wait() ignores threads, and exec() refuses to
+// replace an address space other threads are using.
+//
+void
+testwait()
+{
+  char *argv[] = { "echo", 0 };
+  int tid;
+
+  counter = 0;
+  if((tid = thread_create(spin, 0)) < 0){
+    printf("threadtest: FAIL thread_create\n");
+    exit(1);
+  }
+  if(wait(0) != -1){
+    printf("threadtest: FAIL wait reaped a thread\n");
+    exit(1);
+  }
+  if(exec("echo", argv) != -1){
+    printf("threadtest: FAIL exec with live threads\n");
+    exit(1);
+  }
+  counter = 1;
+  if(thread_join(tid) != tid){
+    printf("threadtest: FAIL thread_join\n");
+    exit(1);
+  }
+}
+
+volatile int tfd;
+
+void
+opener(void *arg)
+{
+  tfd = open("threadtest.tmp", O_CREATE|O_RDWR);
+}
+
+void
+closer(void *arg)
+{
+  close(tfd);
+}
+
+//
+// threads share open files: a descriptor a thread opens stays
+// open for the others after it exits, and closing it in one
+// thread closes it in all.
+//
+void
+testfiles()
+{
+  int tid, fd;
+
+  tfd = -1;
+  if((tid = thread_create(opener, 0)) < 0){
+    printf("threadtest: FAIL thread_create\n");
+    exit(1);
+  }
+  thread_join(tid);
+  if(tfd < 0 || write(tfd, "x", 1) != 1){
+    printf("threadtest: FAIL file opened in thread not shared\n");
+    exit(1);
+  }
+  fd = tfd;
+  if((tid = thread_create(closer, 0)) < 0){
+    printf("threadtest: FAIL thread_create\n");
+    exit(1);
+  }
+  thread_join(tid);
+  if(write(fd, "x", 1) != -1){
+    printf("threadtest: FAIL file closed in thread still open\n");
+    exit(1);
+  }
+  unlink("threadtest.tmp");
+}
+
+//
+// memory doesn't shrink while another thread could be using
+// it, but does once the thread is gone.
+//
+void
+testshrink()
+{
+  int tid;
+
+  counter = 0;
+  if((tid = thread_create(spin, 0)) < 0){
+    printf("threadtest: FAIL thread_create\n");
+    exit(1);
+  }
+  if(sbrk(PGSIZE) == (char*)-1){
+    printf("threadtest: FAIL sbrk\n");
+    exit(1);
+  }
+  if(sbrk(-PGSIZE) != (char*)-1){
+    printf("threadtest: FAIL shrank memory with live threads\n");
+    exit(1);
+  }
+  counter = 1;
+  thread_join(tid);
+  if(sbrk(-PGSIZE) == (char*)-1){
+    printf("threadtest: FAIL cannot shrink memory after join\n");
+    exit(1);
+  }
+}
+
+volatile uint word;
+
+void
+waiter(void *arg)
+{
+  while(word == 0)
+    futex_wait(&word, 0);
+}
+
+//
+// futex_wait() returns at once if the word has changed,
+// and futex_wake() wakes a sleeping thread.
+//
+void
+testfutex()
+{
+  int tid;
+
+  word = 1;
+  if(futex_wait(&word, 0) != -1){
+    printf("threadtest: FAIL futex_wait slept on a changed word\n");
+    exit(1);
+  }
+  word = 0;
+  if((tid = thread_create(waiter, 0)) < 0){
+    printf("threadtest: FAIL thread_create\n");
+    exit(1);
+  }
+  sleep(1);
+  word = 1;
+  futex_wake(&word, 1);
+  if(thread_join(tid) != tid){
+    printf("threadtest: FAIL thread_join\n");
+    exit(1);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf("threadtest: start\n");
+  testcounter();
+  testsbrk();
+  testwait();
+  testfutex();
+  testfiles();
+  testshrink();
+  printf("threadtest: OK\n");
+  exit(0);
+}
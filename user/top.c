@@ -0,0 +1,91 @@
+// Show system activity from sysinfo(): load, per-hart
+// utilization and subsystem counters, once per interval.
+// xv6 has no way to interrupt a program from the console,
+// so top stops after count rounds.
+//
+// usage: top [count [ticks]]
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/sysinfo.h"
+#include "user/user.h"
+
+struct sysinfo prev, cur;
+
+// print a LOAD_SCALE fixed-point number with two decimals.
+void
+printload(uint64 x)
+{
+  uint64 hundredths = (x * 100 + LOAD_SCALE / 2) >> LOAD_SHIFT;
+
+  printf(" %d.%d%d", (int)(hundredths / 100), (int)(hundredths / 10 % 10),
+         (int)(hundredths % 10));
+}
+
+void
+show(int first)
+{
+  uint64 busy, idle, look;
+
+  printf("up %d ticks, %d procs, %d runnable, load average:",
+         (int)cur.ticks, (int)cur.nproc, (int)cur.nrunnable);
+  for(int i = 0; i < 3; i++)
+    printload(cur.loadavg[i]);
+  printf("\nmem: %d KB free\n", (int)(cur.freemem / 1024));
+
+  // totals since boot the first time, then per interval.
+  if(first)
+    memset(&prev, 0, sizeof(prev));
+  for(int i = 0; i < cur.ncpu; i++){
+    busy = cur.cpu[i].busy - prev.cpu[i].busy;
+    idle = cur.cpu[i].idle - prev.cpu[i].idle;
+    printf("cpu%d: %d%% busy (%d busy, %d idle ticks)\n", i,
+           busy + idle ? (int)(busy * 100 / (busy + idle)) : 0,
+           (int)busy, (int)idle);
+  }
+  look = (cur.bhit - prev.bhit) + (cur.bmiss - prev.bmiss);
+  printf("bcache: %d hits, %d misses, %d%% hit",
+         (int)(cur.bhit - prev.bhit), (int)(cur.bmiss - prev.bmiss),
+         look ? (int)((cur.bhit - prev.bhit) * 100 / look) : 0);
+  if(cur.version >= 2)
+    printf(", %d buffers", (int)cur.nbuf);
+  printf("\n");
+  printf("disk: %d blocks read, %d written; log: %d commits\n",
+         (int)(cur.diskread - prev.diskread),
+         (int)(cur.diskwrite - prev.diskwrite),
+         (int)(cur.logcommit - prev.logcommit));
+  printf("pipes: %d bytes read, %d written\n\n",
+         (int)(cur.piperead - prev.piperead),
+         (int)(cur.pipewrite - prev.pipewrite));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int count = 5, delay = 10;
+
+  if(argc > 1)
+    count = atoi(argv[1]);
+  if(argc > 2)
+    delay = atoi(argv[2]);
+  if(argc > 3 || count < 1 || delay < 1){
+    fprintf(2, "Usage: top [count [ticks]]\n");
+    exit(1);
+  }
+
+  for(int i = 0; i < count; i++){
+    if(i > 0)
+      sleep(delay);
+    if(sysinfo(&cur, sizeof(cur)) < 0){
+      fprintf(2, "top: sysinfo failed\n");
+      exit(1);
+    }
+    if(cur.version < 1){
+      fprintf(2, "top: kernel sysinfo is too old\n");
+      exit(1);
+    }
+    show(i == 0);
+    prev = cur;
+  }
+  exit(0);
+}
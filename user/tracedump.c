@@ -0,0 +1,169 @@
+// Trace a command's system calls, or a running process's,
+// into a file in the binary format of kernel/trace.h. Decode
+// it on the host with tools/tracedecode.py.
+//
+// usage: tracedump [-r] [-f] [-a n=val] mask file command ...
+//        tracedump [-f] [-a n=val] -p pid mask file
+//
+// mask is a 64-bit system call mask, in decimal or 0x hex.
+// -f traces only failing calls; -a only calls whose argument
+// n (0..5) is val. The command and its children are traced.
+// -p traces process pid from now until it exits, and returns
+// at once.
+//
+// Events are written straight to the file, so none are lost.
+// With -r they go through the kernel's per-hart trace rings
+// instead, which slows the command less but drops events
+// when a ring fills.
+
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+int fd;
+volatile int done;
+struct traceev buf[32];
+
+// copy events into fd until the command is done and
+// the rings are empty.
+void
+drain(void *arg)
+{
+  int n, last;
+
+  for(;;){
+    // if done was already set, an empty read means
+    // every event has been seen.
+    last = done;
+    n = traceread(buf, sizeof(buf));
+    if(n > 0){
+      if(write(fd, buf, n) != n){
+        fprintf(2, "tracedump: write failed\n");
+        exit(1);
+      }
+    } else if(last){
+      break;
+    } else {
+      sleep(1);
+    }
+  }
+}
+
+// parse a decimal or 0x hexadecimal number.
+// Returns -1 if s is not one.
+int
+number(char *s, uint64 *x)
+{
+  int base = 10, d;
+
+  if(s[0] == '0' && s[1] == 'x'){
+    base = 16;
+    s += 2;
+  }
+  if(*s == 0)
+    return -1;
+  for(*x = 0; *s; s++){
+    if(*s >= '0' && *s <= '9')
+      d = *s - '0';
+    else if(base == 16 && *s >= 'a' && *s <= 'f')
+      d = *s - 'a' + 10;
+    else
+      return -1;
+    *x = *x * base + d;
+  }
+  return 0;
+}
+
+void
+usage(void)
+{
+  fprintf(2, "Usage: tracedump [-r] [-f] [-a n=val] mask file command ...\n"
+             "       tracedump [-f] [-a n=val] -p pid mask file\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct tracectl tc;
+  int pid, tid, rings = 0;
+  uint64 x;
+  char *eq;
+
+  memset(&tc, 0, sizeof(tc));
+  for(; argc > 1 && argv[1][0] == '-'; argc--, argv++){
+    if(strcmp(argv[1], "-r") == 0){
+      rings = 1;
+    } else if(strcmp(argv[1], "-f") == 0){
+      tc.flags |= TRACE_FAILED;
+    } else if(strcmp(argv[1], "-a") == 0 && argc > 2 &&
+              (eq = strchr(argv[2], '=')) != 0){
+      *eq = 0;
+      if(number(argv[2], &x) < 0 || number(eq+1, &tc.val) < 0)
+        usage();
+      tc.flags |= TRACE_ARGEQ;
+      tc.arg = x;
+      argc--, argv++;
+    } else if(strcmp(argv[1], "-p") == 0 && argc > 2){
+      if((tc.pid = atoi(argv[2])) <= 0)
+        usage();
+      argc--, argv++;
+    } else {
+      usage();
+    }
+  }
+  if(argc < 3 || number(argv[1], &tc.mask) < 0 ||
+     (tc.pid == 0 && argc < 4) || (tc.pid != 0 && (argc > 3 || rings)))
+    usage();
+
+  if((fd = open(argv[2], O_CREATE|O_WRONLY)) < 0){
+    fprintf(2, "tracedump: cannot open %s\n", argv[2]);
+    exit(1);
+  }
+
+  if(tc.pid != 0){
+    tc.fd = fd;
+    if(tracectl(&tc) < 0){
+      fprintf(2, "tracedump: cannot trace %d\n", tc.pid);
+      exit(1);
+    }
+    exit(0);
+  }
+
+  // become the reader before any events are traced, so
+  // that none are printed on the console.
+  if(rings)
+    traceread(buf, 0);
+
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "tracedump: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    tc.flags |= TRACE_INHERIT;
+    tc.fd = rings ? -1 : fd;
+    if(tracectl(&tc) < 0){
+      fprintf(2, "tracedump: tracectl failed\n");
+      exit(1);
+    }
+    close(fd);
+    exec(argv[3], argv+3);
+    fprintf(2, "tracedump: exec %s failed\n", argv[3]);
+    exit(1);
+  }
+
+  tid = 0;
+  if(rings && (tid = thread_create(drain, 0)) < 0){
+    fprintf(2, "tracedump: thread_create failed\n");
+    kill(pid);
+  }
+  wait(0);
+  done = 1;
+  if(tid > 0)
+    thread_join(tid);
+  close(fd);
+  exit(0);
+}
@@ -0,0 +1,150 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/syscall.h"
+#include "kernel/trace.h"
+#include "kernel/ring.h"
+#include "user/user.h"
+
+int fds[2];
+
+void
+fail(char *why)
+{
+  printf("tracetest: FAIL %s\n", why);
+  exit(1);
+}
+
+// trace the caller into the pipe.
+void
+settrace(uint64 mask, int flags, int arg, uint64 val)
+{
+  struct tracectl tc;
+
+  memset(&tc, 0, sizeof(tc));
+  tc.mask = mask;
+  tc.flags = flags;
+  tc.fd = fds[1];
+  tc.arg = arg;
+  tc.val = val;
+  if(tracectl(&tc) < 0)
+    fail("tracectl");
+}
+
+// the next event must be system call num by pid, returning ret.
+void
+expect(int num, int pid, uint64 ret)
+{
+  struct traceev e;
+
+  if(read(fds[0], &e, sizeof(e)) != sizeof(e))
+    fail("short read");
+  if(e.num != num || e.pid != pid || e.ret != ret){
+    printf("tracetest: got syscall %d pid %d ret %d\n", e.num, e.pid, (int)e.ret);
+    fail("wrong event");
+  }
+}
+
+//
+// events go to the fd, and calls numbered 32 and up work.
+//
+void
+testfd()
+{
+  int pid = getpid();
+
+  // the mask is checked when the call returns.
+  settrace(1L << SYS_getpid | 1L << SYS_tracectl, 0, 0, 0);
+  expect(SYS_tracectl, pid, 0);
+  getpid();
+  expect(SYS_getpid, pid, pid);
+  settrace(0, 0, 0, 0);
+}
+
+//
+// only failing calls, and only calls with a given argument.
+//
+void
+testpredicates()
+{
+  int pid = getpid();
+
+  settrace(1L << SYS_open | 1L << SYS_getpid, TRACE_FAILED, 0, 0);
+  close(open("README", 0));
+  getpid();
+  open("tracetest-nonexistent", 0);
+  expect(SYS_open, pid, -1);
+
+  settrace(1L << SYS_close | 1L << SYS_getpid, TRACE_ARGEQ, 0, 42);
+  close(41);
+  close(42);
+  expect(SYS_close, pid, -1);
+  settrace(0, 0, 0, 0);
+}
+
+//
+// children are traced only with TRACE_INHERIT.
+//
+void
+testinherit()
+{
+  int pid, cpid;
+
+  pid = getpid();
+  settrace(1L << SYS_getpid, 0, 0, 0);
+  cpid = fork();
+  if(cpid == 0){
+    getpid();
+    exit(0);
+  }
+  wait(0);
+  getpid();
+  expect(SYS_getpid, pid, pid);
+
+  settrace(1L << SYS_getpid, TRACE_INHERIT, 0, 0);
+  cpid = fork();
+  if(cpid == 0){
+    getpid();
+    exit(0);
+  }
+  wait(0);
+  expect(SYS_getpid, cpid, cpid);
+  settrace(0, 0, 0, 0);
+}
+
+//
+// calls made through the submission ring are traced too,
+// with their arguments.
+//
+void
+testring()
+{
+  struct ringcqe c;
+  int pid = getpid();
+
+  settrace(1L << SYS_close, TRACE_ARGEQ, 0, 42);
+  if(ring_prep(SYS_close, 41, 0, 0, 0, 0) < 0 ||
+     ring_prep(SYS_close, 42, 0, 0, 0, 0) < 0)
+    fail("ring_prep");
+  if(ring_submit() != 2)
+    fail("ring_submit");
+  while(ring_reap(&c))
+    ;
+  expect(SYS_close, pid, -1);
+  settrace(0, 0, 0, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf("tracetest: start\n");
+  if(pipe(fds) < 0)
+    fail("pipe");
+  if(traceread(fds, -1) != -1)
+    fail("traceread with a negative size");
+  testfd();
+  testpredicates();
+  testinherit();
+  testring();
+  printf("tracetest: OK\n");
+  exit(0);
+}
@@ -1,6 +1,10 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/param.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/usyscall.h"
 #include "user/user.h"
 
 char*
@@ -134,3 +138,34 @@ memcpy(void *dst, const void *src, uint n)
 {
   return memmove(dst, src, n);
 }
+
+// getpid(), uptime() and the time CSR without a trap, from
+// the page the kernel maps at USYSCALL. Threads share it, so
+// in a thread ugetpid() is the pid of the process that
+// created it; use getpid() for the thread's own.
+int
+ugetpid(void)
+{
+  return ((struct usyscall *)USYSCALL)->pid;
+}
+
+int
+uuptime(void)
+{
+  return ((volatile struct usyscall *)USYSCALL)->ticks;
+}
+
+// cycles since boot; ufreq() of them per second.
+uint64
+uclock(void)
+{
+  uint64 x;
+  asm volatile("rdtime %0" : "=r" (x) );
+  return x;
+}
+
+uint64
+ufreq(void)
+{
+  return ((struct usyscall *)USYSCALL)->freq;
+}
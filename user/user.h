@@ -2,6 +2,13 @@
 struct stat;
 struct rtcdate;
 struct sysinfo;
+struct schedstat;
+struct rusage;
+struct scstat;
+struct ring;
+struct ringcqe;
+struct tracectl;
+struct lockstat;
 
 // system calls
 int fork(void);
@@ -26,7 +33,25 @@ char* sbrk(int);
 int sleep(int);
 int uptime(void);
 int trace(int);
-int sysinfo(struct sysinfo*);
+int sysinfo(struct sysinfo*, int);
+int clone(void(*)(void*), void*, void*);
+int join(int, void**);
+int futex_wait(volatile uint*, uint);
+int futex_wake(volatile uint*, int);
+int sched_setaffinity(int, uint64);
+uint64 sched_getaffinity(int);
+int schedstat(int, struct schedstat*);
+int sched_setrt(int, int, int, int);
+int wait3(int*, struct rusage*);
+int getrusage(int, struct rusage*);
+int traceread(void*, int);
+int scstat(int, struct scstat*);
+int scprofile(int);
+struct ring* ring_setup(void);
+int ring_enter(int);
+int tracectl(struct tracectl*);
+int lockstat(struct lockstat*, int);
+int diskctl(int, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -44,3 +69,24 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+int ugetpid(void);
+int uuptime(void);
+uint64 uclock(void);
+uint64 ufreq(void);
+
+// thread.c
+struct tlock {
+  volatile uint locked;  // 0 free, 1 held, 2 held with waiters
+};
+int thread_create(void (*)(void*), void*);
+int thread_join(int);
+void tlock_init(struct tlock*);
+void tlock_acquire(struct tlock*);
+void tlock_release(struct tlock*);
+
+// ring.c
+extern struct ring *ring;
+int ring_prep(int, uint64, uint64, uint64, uint64, int);
+int ring_submit(void);
+int ring_reap(struct ringcqe*);
+int rread(int, void*, int);
@@ -38,3 +38,21 @@ entry("sleep");
 entry("uptime");
 entry("trace");
 entry("sysinfo");
+entry("clone");
+entry("join");
+entry("futex_wait");
+entry("futex_wake");
+entry("sched_setaffinity");
+entry("sched_getaffinity");
+entry("schedstat");
+entry("sched_setrt");
+entry("wait3");
+entry("getrusage");
+entry("traceread");
+entry("scstat");
+entry("scprofile");
+entry("ring_setup");
+entry("ring_enter");
+entry("tracectl");
+entry("lockstat");
+entry("diskctl");
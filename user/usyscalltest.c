@@ -0,0 +1,99 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+#define N 1000
+
+void
+fail(char *why)
+{
+  printf("usyscalltest: FAIL %s\n", why);
+  exit(1);
+}
+
+void
+testpid()
+{
+  int pid, status;
+
+  if(ugetpid() != getpid())
+    fail("ugetpid");
+  pid = fork();
+  if(pid < 0)
+    fail("fork");
+  if(pid == 0)
+    exit(ugetpid() == getpid() ? 0 : 1);
+  wait(&status);
+  if(status != 0)
+    fail("ugetpid in child");
+}
+
+void
+testtime()
+{
+  uint64 t0, t1;
+  int u0, u1;
+
+  u0 = uuptime();
+  if(u0 < uptime() - 1 || u0 > uptime())
+    fail("uuptime");
+  t0 = uclock();
+  sleep(5);
+  t1 = uclock();
+  u1 = uuptime();
+  if(u1 < u0 + 5)
+    fail("uuptime did not advance");
+  // sleep(5) lasts between 4 and 6 ticks, give or take.
+  if(t1 - t0 < 4 * ufreq() / 10 || t1 - t0 > 8 * ufreq() / 10)
+    fail("uclock");
+}
+
+// the page is read-only, so a store to it kills the process.
+void
+testreadonly()
+{
+  int pid, status;
+
+  pid = fork();
+  if(pid < 0)
+    fail("fork");
+  if(pid == 0){
+    *(volatile int *)USYSCALL = 0;
+    exit(0);
+  }
+  wait(&status);
+  if(status != -1)
+    fail("USYSCALL is writable");
+}
+
+void
+bench()
+{
+  uint64 t0, t1, t2;
+  int i;
+
+  t0 = uclock();
+  for(i = 0; i < N; i++)
+    getpid();
+  t1 = uclock();
+  for(i = 0; i < N; i++)
+    ugetpid();
+  t2 = uclock();
+  printf("getpid %d ns, ugetpid %d ns\n",
+         (int)((t1 - t0) * 1000000000 / ufreq() / N),
+         (int)((t2 - t1) * 1000000000 / ufreq() / N));
+}
+
+int
+main(int argc, char *argv[])
+{
+  printf("usyscalltest: start\n");
+  testpid();
+  testtime();
+  testreadonly();
+  bench();
+  printf("usyscalltest: OK\n");
+  exit(0);
+}